@@ -96,6 +96,16 @@ static uint8_t gs_uc_tx_buffer[GMAC_TX_BUFFERS * GMAC_TX_UNITSIZE];
 COMPILER_ALIGNED(8)
 static uint8_t gs_uc_rx_buffer[GMAC_RX_BUFFERS * GMAC_RX_UNITSIZE];
 
+#ifdef GMAC_RX_PRIORITY_BUFFERS
+/** RX descriptors list of the priority queue */
+COMPILER_ALIGNED(8)
+static gmac_rx_descriptor_t gs_rx_desc_pq[GMAC_RX_PRIORITY_BUFFERS];
+
+/** Receive Buffer of the priority queue */
+COMPILER_ALIGNED(8)
+static uint8_t gs_uc_rx_buffer_pq[GMAC_RX_PRIORITY_BUFFERS * GMAC_RX_UNITSIZE];
+#endif
+
 /**
  * GMAC device memory management struct.
  */
@@ -308,6 +318,16 @@ static void gmac_init_queue(Gmac* p_gmac, gmac_device_t* p_gmac_dev)
 
 	gmac_init_mem(p_gmac_dev, GMAC_QUE_0, &gmac_dev_mm, gs_tx_callback);
 
+#ifdef GMAC_RX_PRIORITY_BUFFERS
+	/* Receive only ring for the priority queue, transmission stays on queue 0.
+	   Same buffer size as queue 0 (in units of 64 bytes) so frames are handled alike. */
+	p_gmac_dev->gmac_queue_list[GMAC_RX_PRIORITY_QUEUE].p_rx_buffer = gs_uc_rx_buffer_pq;
+	p_gmac_dev->gmac_queue_list[GMAC_RX_PRIORITY_QUEUE].p_rx_dscr = gs_rx_desc_pq;
+	p_gmac_dev->gmac_queue_list[GMAC_RX_PRIORITY_QUEUE].us_rx_list_size = GMAC_RX_PRIORITY_BUFFERS;
+	gmac_set_rx_priority_bufsize(p_gmac, GMAC_RX_UNITSIZE / 64, GMAC_RX_PRIORITY_QUEUE);
+	gmac_reset_rx_mem(p_gmac_dev, GMAC_RX_PRIORITY_QUEUE);
+#endif
+
 
 	/* Enable Rx and Tx, plus the statistics register */
 	gmac_enable_transmit(p_gmac, true);
@@ -375,6 +395,23 @@ void gmac_dev_init(Gmac* p_gmac, gmac_device_t* p_gmac_dev,
 #endif
 }
 
+/**
+ * \brief Steer received UDP frames into a priority queue with a type 1 screener.
+ * Frames that match no screener keep going to queue 0.
+ *
+ * \param p_gmac_dev Pointer to the GMAC device instance.
+ * \param ul_index Index of the type 1 screener register (0-3).
+ * \param us_port UDP destination port to match.
+ * \param queue_idx Priority queue receiving the matching frames.
+ */
+void gmac_dev_set_udp_screener(gmac_device_t* p_gmac_dev, uint32_t ul_index, uint16_t us_port,
+		gmac_quelist_t queue_idx)
+{
+	gmac_write_screener_reg_1(p_gmac_dev->p_hw,
+			GMAC_ST1RPQ_QNB(queue_idx) | GMAC_ST1RPQ_UDPM(us_port) | GMAC_ST1RPQ_UDPE,
+			ul_index);
+}
+
 /**
  * \brief Return the number of RX buffer full.
  *
@@ -506,6 +543,101 @@ uint32_t gmac_dev_read(gmac_device_t* p_gmac_dev, gmac_quelist_t queue_idx, uint
 	return GMAC_RX_NO_DATA;
 }
 
+/**
+ * \brief Borrow a complete frame directly from the GMAC receive buffers.
+ * Unlike gmac_dev_read() the frame is not copied: *pp_frame points into the RX
+ * descriptor ring. Only when the frame wraps around the end of the ring it is
+ * copied into p_bounce so the caller always sees a contiguous frame.
+ * Descriptors in front of us_sof_idx (fragments without end of frame) are given
+ * back to the GMAC, the descriptors of the frame stay owned by software until
+ * gmac_dev_rx_release() is called.
+ *
+ * \param p_gmac_dev Pointer to the GMAC device instance.
+ * \param us_sof_idx RX descriptor holding the start of the frame, the frame must be complete.
+ * \param pp_frame Returns the address of the frame.
+ * \param p_bounce Buffer used for frames that wrap around the ring.
+ * \param ul_bounce_size Size of p_bounce.
+ * \param p_rcv_size   Received frame size.
+ *
+ * \return GMAC_OK if the frame is available, otherwise failed.
+ */
+uint32_t gmac_dev_rx_peek(gmac_device_t* p_gmac_dev, gmac_quelist_t queue_idx, uint16_t us_sof_idx,
+		uint8_t** pp_frame, uint8_t* p_bounce, uint32_t ul_bounce_size, uint32_t* p_rcv_size)
+{
+	uint32_t ul_first_size;
+	gmac_queue_t* p_gmac_queue = &p_gmac_dev->gmac_queue_list[queue_idx];
+	uint16_t us_tmp_idx = us_sof_idx;
+	gmac_rx_descriptor_t *p_sof_td;
+	gmac_rx_descriptor_t *p_rx_td;
+
+	if (pp_frame == NULL || p_bounce == NULL || us_sof_idx >= p_gmac_queue->us_rx_list_size)
+		return GMAC_PARAM;
+
+	/* Set the default return value */
+	*p_rcv_size = 0;
+
+	/* Discard the fragments in front of the frame */
+	while (p_gmac_queue->us_rx_idx != us_sof_idx) {
+		p_gmac_queue->p_rx_dscr[p_gmac_queue->us_rx_idx].addr.val &= ~(GMAC_RXD_OWNERSHIP);
+		circ_inc(&p_gmac_queue->us_rx_idx, p_gmac_queue->us_rx_list_size);
+	}
+
+	p_sof_td = &p_gmac_queue->p_rx_dscr[us_sof_idx];
+	if (((p_sof_td->addr.val & GMAC_RXD_OWNERSHIP) != GMAC_RXD_OWNERSHIP) ||
+			((p_sof_td->status.val & GMAC_RXD_SOF) != GMAC_RXD_SOF))
+		return GMAC_RX_ERROR;
+
+	/* Walk to the end of the frame */
+	p_rx_td = p_sof_td;
+	while ((p_rx_td->status.val & GMAC_RXD_EOF) != GMAC_RXD_EOF) {
+		circ_inc(&us_tmp_idx, p_gmac_queue->us_rx_list_size);
+		p_rx_td = &p_gmac_queue->p_rx_dscr[us_tmp_idx];
+		if ((us_tmp_idx == us_sof_idx) || ((p_rx_td->addr.val & GMAC_RXD_OWNERSHIP) != GMAC_RXD_OWNERSHIP))
+			return GMAC_RX_ERROR;
+	}
+
+	*p_rcv_size = (p_rx_td->status.val & GMAC_RXD_LEN_MASK);
+	*pp_frame = (uint8_t *)(p_sof_td->addr.val & GMAC_RXD_ADDR_MASK);
+
+	/* Frame wraps around the ring, gather it in the bounce buffer */
+	if (p_rx_td < p_sof_td) {
+		if (*p_rcv_size > ul_bounce_size) {
+			return GMAC_SIZE_TOO_SMALL;
+		}
+		ul_first_size = (uint32_t)(&p_gmac_queue->p_rx_dscr[p_gmac_queue->us_rx_list_size] - p_sof_td)
+				* GMAC_RX_UNITSIZE;
+		memcpy(p_bounce, *pp_frame, ul_first_size);
+		memcpy(p_bounce + ul_first_size,
+				(void *)(p_gmac_queue->p_rx_dscr[0].addr.val & GMAC_RXD_ADDR_MASK),
+				*p_rcv_size - ul_first_size);
+		*pp_frame = p_bounce;
+	}
+	return GMAC_OK;
+}
+
+/**
+ * \brief Give the RX descriptors of the frame returned by gmac_dev_rx_peek()
+ * back to the GMAC.
+ *
+ * \param p_gmac_dev Pointer to the GMAC device instance.
+ */
+void gmac_dev_rx_release(gmac_device_t* p_gmac_dev, gmac_quelist_t queue_idx)
+{
+	gmac_queue_t* p_gmac_queue = &p_gmac_dev->gmac_queue_list[queue_idx];
+	gmac_rx_descriptor_t *p_rx_td;
+	uint32_t ul_status;
+
+	do {
+		p_rx_td = &p_gmac_queue->p_rx_dscr[p_gmac_queue->us_rx_idx];
+		if ((p_rx_td->addr.val & GMAC_RXD_OWNERSHIP) == 0) {
+			break;
+		}
+		ul_status = p_rx_td->status.val;
+		p_rx_td->addr.val &= ~(GMAC_RXD_OWNERSHIP);
+		circ_inc(&p_gmac_queue->us_rx_idx, p_gmac_queue->us_rx_list_size);
+	} while ((ul_status & GMAC_RXD_EOF) == 0);
+}
+
 /**
  * \brief Return the number of TX buffer waiting for transfer.
  *
@@ -639,6 +771,41 @@ uint32_t gmac_dev_write_nocopy(gmac_device_t* p_gmac_dev, gmac_quelist_t queue_i
 	return GMAC_OK;
 }
 
+/**
+ * \brief Send a frame that stays in the caller's buffer, e.g. a prebuilt template.
+ * The current transmit descriptor is pointed at p_buffer and sent with
+ * gmac_dev_write_nocopy(). The descriptor gets its ring buffer back once the
+ * frame has been sent, p_buffer must not change until then.
+ *
+ * \param p_gmac_dev Pointer to the GMAC device instance.
+ * \param p_buffer   Pointer to the frame, 8-byte aligned.
+ * \param ul_size    Length of the frame.
+ * \param func_tx_cb  Transmit callback function.
+ *
+ * \return GMAC_OK, GMAC_TX_BUSY or GMAC_PARAM.
+ */
+uint32_t gmac_dev_write_static(gmac_device_t* p_gmac_dev, gmac_quelist_t queue_idx, const void *p_buffer,
+		uint32_t ul_size, gmac_dev_tx_cb_t func_tx_cb)
+{
+	gmac_queue_t* p_gmac_queue = &p_gmac_dev->gmac_queue_list[queue_idx];
+
+	/* Check parameter before the descriptor is lent to p_buffer */
+	if (p_buffer == NULL || ((uint32_t) p_buffer & 0x7)
+			|| ul_size > GMAC_TX_UNITSIZE) {
+		return GMAC_PARAM;
+	}
+
+	/* If no free TxTd, buffer can't be sent */
+	if (CIRC_SPACE(p_gmac_queue->us_tx_head, p_gmac_queue->us_tx_tail,
+					p_gmac_queue->us_tx_list_size) == 0) {
+		return GMAC_TX_BUSY;
+	}
+
+	p_gmac_queue->p_tx_dscr[p_gmac_queue->us_tx_head].addr = (uint32_t) p_buffer;
+
+	return gmac_dev_write_nocopy(p_gmac_dev, queue_idx, ul_size, func_tx_cb);
+}
+
 uint8_t *gmac_dev_get_tx_buffer(gmac_device_t* p_gmac_dev, gmac_quelist_t queue_idx)
 {
 	volatile gmac_tx_descriptor_t *p_tx_td;
@@ -846,6 +1013,9 @@ void gmac_handler(gmac_device_t* p_gmac_dev, gmac_quelist_t queue_idx)
 					break;
 				}
 
+				/* Give the descriptor its ring buffer back after gmac_dev_write_static() */
+				p_tx_td->addr = (uint32_t) &p_gmac_queue->p_tx_buffer[p_gmac_queue->us_tx_tail * GMAC_TX_UNITSIZE];
+
 				/* Notify upper layer that a packet has been sent */
 				if (*p_tx_cb) {
 					(*p_tx_cb) (ul_tx_status_flag);
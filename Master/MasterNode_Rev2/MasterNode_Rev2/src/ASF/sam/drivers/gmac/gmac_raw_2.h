@@ -113,14 +113,21 @@ typedef struct gmac_device {
 
 void gmac_dev_init(Gmac* p_gmac, gmac_device_t* p_gmac_dev,
 		gmac_options_t* p_opt);
+void gmac_dev_set_udp_screener(gmac_device_t* p_gmac_dev, uint32_t ul_index, uint16_t us_port,
+		gmac_quelist_t queue_idx);
 uint32_t gmac_dev_rx_buf_used(gmac_device_t* p_gmac_dev, gmac_quelist_t queue_idx);
 uint32_t gmac_dev_read(gmac_device_t* p_gmac_dev, gmac_quelist_t queue_idx, uint8_t* p_frame,
 		uint32_t ul_frame_size, uint32_t* p_rcv_size);
+uint32_t gmac_dev_rx_peek(gmac_device_t* p_gmac_dev, gmac_quelist_t queue_idx, uint16_t us_sof_idx,
+		uint8_t** pp_frame, uint8_t* p_bounce, uint32_t ul_bounce_size, uint32_t* p_rcv_size);
+void gmac_dev_rx_release(gmac_device_t* p_gmac_dev, gmac_quelist_t queue_idx);
 uint32_t gmac_dev_tx_buf_used(gmac_device_t* p_gmac_dev, gmac_quelist_t queue_idx);
 uint32_t gmac_dev_write(gmac_device_t* p_gmac_dev, gmac_quelist_t queue_idx, void *p_buffer,
 		uint32_t ul_size, gmac_dev_tx_cb_t func_tx_cb);
 uint32_t gmac_dev_write_nocopy(gmac_device_t* p_gmac_dev, gmac_quelist_t queue_idx,
 		uint32_t ul_size, gmac_dev_tx_cb_t func_tx_cb);
+uint32_t gmac_dev_write_static(gmac_device_t* p_gmac_dev, gmac_quelist_t queue_idx, const void *p_buffer,
+		uint32_t ul_size, gmac_dev_tx_cb_t func_tx_cb);
 uint8_t *gmac_dev_get_tx_buffer(gmac_device_t* p_gmac_dev, gmac_quelist_t queue_idx);
 uint32_t gmac_dev_get_tx_load(gmac_device_t* p_gmac_dev, gmac_quelist_t queue_idx);
 void gmac_dev_set_rx_callback(gmac_device_t* p_gmac_dev, gmac_quelist_t queue_idx,
@@ -50,6 +50,12 @@ extern "C" {
 /** Number of buffer for RX */
 #define GMAC_RX_BUFFERS  16
 
+/** Priority queue receiving the frames steered by the screeners (Art-Net) */
+#define GMAC_RX_PRIORITY_QUEUE  GMAC_QUE_1
+
+/** Number of buffer for RX on the priority queue */
+#define GMAC_RX_PRIORITY_BUFFERS  32
+
 /** Number of buffer for TX */
 #define GMAC_TX_BUFFERS  16
 
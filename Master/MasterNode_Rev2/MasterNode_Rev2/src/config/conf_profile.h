@@ -0,0 +1,29 @@
+/*
+ * conf_profile.h
+ *
+ * Created: 17/10/2026 20:11:36
+ *  Author: Design
+ */
+
+
+#ifndef CONF_PROFILE_H_INCLUDED
+#define CONF_PROFILE_H_INCLUDED
+
+#include <asf.h>
+
+/* Build the cycle counter probes of the master pipeline (Master/libraries/profile),
+   answered by the "Profile&" and "ProfileHist&" ArtCommands. Comment out to compile the probes away. */
+#define PROFILE_ENABLE
+
+#define PROFILE_CPU_HZ()        sysclk_get_cpu_hz()
+
+/* Probes, all in the main loop */
+#define PROFILE_PROBES(X) \
+	X(PROF_LOOP,        "loop")       /* one main loop pass without the sleep */ \
+	X(PROF_ETH_RX,      "eth rx")     /* peek_dev_gmac(), frame from the GMAC RX ring */ \
+	X(PROF_PACKET,      "packet")     /* handleGMAC_Packet() */ \
+	X(PROF_RADIO_POLL,  "radio poll") /* nRF24_txPoll() of all radios */ \
+	X(PROF_ARTNET_CMD,  "artnetCmd")  /* artnetToCommand() */ \
+	X(PROF_NRF_QUEUE,   "nRF queue")  /* nRF24_txQueue(), part of artnetCmd */
+
+#endif /* CONF_PROFILE_H_INCLUDED */
@@ -47,8 +47,184 @@ long map(long x, long in_min, long in_max, long out_min, long out_max) {
 	return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
 }
 
+/************************************************************************/
+/*    Triple buffered DMX store                                         */
+/************************************************************************/
+
+/**
+ * \brief Buffer the network side fills with the next DMX frame
+ */
+uint8_t *dmx_buffer_write(void)
+{
+	return artnet_dmx_buffer[dmx_write_idx];
+}
+
+/**
+ * \brief Hand the buffer filled by the network side over to the radio side
+ * The previously shared buffer becomes the new write buffer.
+ */
+void dmx_buffer_publish(uint16_t stamp)
+{
+	artnet_dmx_stamp[dmx_write_idx] = stamp;
+	dmx_write_idx = __atomic_exchange_n(&dmx_shared_idx, dmx_write_idx | DMX_FRESH, __ATOMIC_ACQ_REL) & ~DMX_FRESH;
+}
+
+/**
+ * \brief Take the most recent DMX frame for the radio side
+ * The returned snapshot is stable until the next call, whatever the network side does.
+ */
+const uint8_t *dmx_buffer_read(void)
+{
+	if (dmx_shared_idx & DMX_FRESH)
+	{
+		dmx_read_idx = __atomic_exchange_n(&dmx_shared_idx, dmx_read_idx, __ATOMIC_ACQ_REL) & ~DMX_FRESH;
+	}
+	return artnet_dmx_buffer[dmx_read_idx];
+}
+
+/**
+ * \brief Trace timestamp of the frame last returned by dmx_buffer_read()
+ */
+uint16_t dmx_buffer_stamp(void)
+{
+	return artnet_dmx_stamp[dmx_read_idx];
+}
+
+/************************************************************************/
+/*    Universe routing                                                  */
+/************************************************************************/
+
+/**
+ * \brief Hash a 15 bit Port-Address onto a universeRoute slot
+ */
+static inline uint8_t universe_route_hash(uint16_t portAddress)
+{
+	return (uint8_t)((portAddress ^ (portAddress >> 4) ^ (portAddress >> 8)) & (UNIVERSE_ROUTE_SLOTS - 1));
+}
+
+/**
+ * \brief Build the universe routing table from universePatch
+ * Patches that do not fit in MAX_NODES are left out.
+ */
+void universe_routes_init(void)
+{
+	uint8_t p;
+	uint8_t slot;
+	
+	memset(universeBitmap, 0, sizeof(universeBitmap));
+	memset(universeRoute, UNIVERSE_ROUTE_EMPTY, sizeof(universeRoute));
+	for (p = 0; p < UNIVERSE_PATCHES && p < UNIVERSE_ROUTE_SLOTS; p++)
+	{
+		const T_UniversePatch *patch = &universePatch[p];
+		
+		if ((patch->portAddress >= PORT_ADDRESSES) || (patch->dmxAddress == 0) ||
+			(patch->firstNode + patch->nodeCount > MAX_NODES))
+		{
+#ifdef _DEBUG_
+	printf("Patch %d ignored\r\n", p);
+#endif
+			continue;
+		}
+		slot = universe_route_hash(patch->portAddress);
+		while (universeRoute[slot] != UNIVERSE_ROUTE_EMPTY)
+		{
+			slot = (slot + 1) & (UNIVERSE_ROUTE_SLOTS - 1);
+		}
+		universeRoute[slot] = p;
+		universeBitmap[patch->portAddress >> 5] |= (1UL << (patch->portAddress & 0x1F));
+	}
+}
+
+/**
+ * \brief Copy the channels of every patch on a universe into dmx_node_image
+ * \return true when the universe is patched
+ */
+bool dmx_patch_universe(uint16_t portAddress, const uint8_t *data, uint16_t length)
+{
+	uint8_t slot;
+	uint16_t start;
+	uint16_t count;
+	
+	portAddress &= (PORT_ADDRESSES - 1);
+	if (!(universeBitmap[portAddress >> 5] & (1UL << (portAddress & 0x1F))))
+	{
+		return false;
+	}
+	for (slot = universe_route_hash(portAddress); universeRoute[slot] != UNIVERSE_ROUTE_EMPTY; slot = (slot + 1) & (UNIVERSE_ROUTE_SLOTS - 1))
+	{
+		const T_UniversePatch *patch = &universePatch[universeRoute[slot]];
+		
+		if (patch->portAddress != portAddress)
+		{
+			continue;
+		}
+		start = patch->dmxAddress - 1; //Art-Net data array has the first data byte at 0
+		if (start >= length)
+		{
+			continue;
+		}
+		if (patch->firstNode == 0)
+		{
+			dmx_node_image[0] = data[start]; //channel n belongs to the block of slave node 1
+		}
+		start++;
+		count = patch->nodeCount * NODE_CHANNELS;
+		if (start + count > length)
+		{
+			count = (start < length) ? (length - start) : 0;
+		}
+		memcpy(&dmx_node_image[1 + (patch->firstNode * NODE_CHANNELS)], &data[start], count);
+	}
+	return true;
+}
+
+/**
+ * \brief Leave ArtSync mode when the controller stopped sending ArtSync
+ * The frames staged since the last ArtSync are published right away.
+ */
+static void artsync_timeout(void)
+{
+#ifdef _DEBUG_
+	eventlog_write(EV_ARTSYNC_TIMEOUT, 0, 0);
+#endif
+	artSyncMode = false;
+	artSyncTicks = 0;
+	memcpy(dmx_buffer_write(), dmx_node_image, DMX_IMAGE_SIZE);
+	dmx_buffer_publish(dmx_image_stamp);
+}
+
+/*
+ *	\brief Translate the DMX value of a node function channel to a command
+ */
+static e_command nodeFunctionToCommand(uint8_t nodeFunction)
+{
+	if (nodeFunction <= 30)
+		return disabled;
+	if (nodeFunction <= 60)
+		return active_hue;
+	if (nodeFunction <= 90)
+		return active_sat;
+	if (nodeFunction <= 120)
+		return active_int;
+	if (nodeFunction <= 150)
+		return receive_hue;
+	if (nodeFunction <= 180)
+		return receive_sat;
+	if (nodeFunction <= 210)
+		return receive_int;
+	return reset;
+}
+
 /*
  *	\brief Send commands in function of the received Art-Net data
+ *	Called every radio tick (RADIO_OUTPUT_RATE) with the latest DMX frame.
+ *	The channels below are relative to the universe and DMX address of the
+ *	universePatch entry the node belongs to, dmx_data holds them packed.
+ *	Only nodes whose data changed since the last transmission are sent,
+ *	unchanged nodes are refreshed every NODE_KEEPALIVE_TICKS ticks.
+ *	At most RADIO_TX_BUDGET nodes per radio are sent per tick, the remaining nodes
+ *	stay dirty and are served first on the next tick.
+ *	On an ArtSync (burst) the budget is lifted so every node is sent at once.
  *
  * Art-Net functionality			                                    
  *	
@@ -104,17 +280,278 @@ long map(long x, long in_min, long in_max, long out_min, long out_max) {
  *	channel n+16: Dimmer
  *	
 */
-static void artnetToCommand(void)
+/**
+ * \brief Radio serving node n (0 based)
+ */
+static inline nrf24_t *node_radio(uint8_t n)
 {
-	__disable_irq(); // Set PRIMASK
+	return &radio[n / nodesPerRadio];
+}
 
-	//NVIC_DisableIRQ(GMAC_IRQn);
+/**
+ * \brief Next trace sequence number, RF_TRACE_NONE is skipped
+ * Without LATENCY_TRACE every frame goes untraced.
+ */
+static uint8_t trace_next_seq(uint8_t *p_seq)
+{
+#ifdef LATENCY_TRACE
+	if (++(*p_seq) == RF_TRACE_NONE)
+	{
+		++(*p_seq);
+	}
+	return *p_seq;
+#else
+	UNUSED(p_seq);
+	return RF_TRACE_NONE;
+#endif
+}
+
+#ifndef RADIO_BROADCAST
+static void radio_tx_done(nrf24_t *dev, uint8_t slot, bool ack, uint8_t retries, const uint8_t *ack_payload, uint8_t ack_len)
+{
+	const struct sensorStruct *p_sensor = (const struct sensorStruct *)ack_payload;
+	int16_t sample = (ack ? retries : LINK_LOST_RETRIES) * 16;
 	
+	//runs in the nRF24 IRQ interrupt, the slot is the node on every radio
+	UNUSED(dev);
+	if (slot == RF_ANNOUNCE_SLOT) {
+		return;
+	}
+	nodeLinkRetries[slot] += (sample - nodeLinkRetries[slot]) >> LINK_AVG_SHIFT;
+	if (ack) {
+		nodeTxAcked |= (1 << slot);
+		if ((ack_len >= sizeof(struct sensorStruct)) && (p_sensor->header == RF_FRAME_HEADER(RF_FRAME_SENSOR)) && (p_sensor->srcNode == (slot + 1))) {
+			nodeSensor[slot] = p_sensor->sensorVal;
+			nodeSensorFresh |= (1 << slot);
+			//trace report of an earlier frame: Art-Net to ACK plus receive to FastLED.show() on the slave
+			if ((p_sensor->seq != RF_TRACE_NONE) && (p_sensor->seq == nodeTrace[slot].seq) && (p_sensor->showUs != RF_SHOW_NONE)) {
+				latency_record(slot, nodeTrace[slot].air_us + p_sensor->showUs);
+				nodeTrace[slot].seq = RF_TRACE_NONE;
+			}
+		}
+		if (nodeSent[slot].seq != RF_TRACE_NONE) {
+			nodeTrace[slot].seq = nodeSent[slot].seq;
+			nodeTrace[slot].air_us = latency_since_us(nodeSent[slot].stamp);
+		}
+	}
+	else {
+		nodeTxFailed |= (1 << slot);
+	}
+}
+
+/**
+ * \brief Retune the retransmissions of a node from its link quality
+ * ARD is 250us * (delay + 1), the worst case airtime of a node stays below ~6ms.
+ */
+static void radio_link_retries(uint8_t n)
+{
+	uint8_t quality = nodeLinkRetries[n];
+	
+	if (quality < LINK_GOOD)
+	{
+		nRF24_txSetRetries(node_radio(n), n, 1, 3); //500us, 3 retries
+	}
+	else if (quality < LINK_FAIR)
+	{
+		nRF24_txSetRetries(node_radio(n), n, 2, 6); //750us, 6 retries
+	}
+	else
+	{
+		nRF24_txSetRetries(node_radio(n), n, 3, 5); //1ms, 5 retries
+	}
+}
+
+/**
+ * \brief Move the nodes acknowledged since the last call into the shadow
+ * Failed nodes are left dirty so they are retried on the next frame.
+ */
+static void radio_tx_collect(void)
+{
+	uint16_t acked = __atomic_exchange_n(&nodeTxAcked, 0, __ATOMIC_RELAXED);
+	uint16_t failed = __atomic_exchange_n(&nodeTxFailed, 0, __ATOMIC_RELAXED);
+	uint16_t sensed = __atomic_exchange_n(&nodeSensorFresh, 0, __ATOMIC_RELAXED);
+	uint8_t n;
+	
+	for (n = 0; n < nodes; n++)
+	{
+		if (acked & (1 << n))
+		{
+			nodeShadow[n] = nodeSent[n];
+			nodeShadowValid |= (1 << n);
+			nodeKeepalive[n] = 0;
+		}
+	}
+#ifdef _DEBUG_
+	if (failed) {
+		eventlog_write(EV_TX_FAILED, failed, 0);
+	}
+	for (n = 0; n < nodes; n++)
+	{
+		if (sensed & (1 << n))
+		{
+			eventlog_write(EV_SENSOR, EVENTLOG_BYTES(n + 1, nodeSensor[n], 0, 0), 0);
+		}
+	}
+#else
+	UNUSED(failed);
+	UNUSED(sensed);
+#endif
+}
+#else
+/**
+ * \brief Send the nodes in broadcast frames, one frame per BROADCAST_SLICES nodes of a radio
+ * A frame is sent when one of its nodes changed or when its keepalive expired.
+ * Frames are not acknowledged, the nodes are moved into the shadow when queued.
+ * Like the unicast path nodes with a command that is not implemented are not sent new data,
+ * their slice repeats what the node was last sent.
+ */
+static void radio_broadcast(const struct dataStruct *nodeData, uint16_t dirtyNodes)
+{
+	struct broadcastStruct *p_frame;
+	const struct dataStruct *p_node;
+	uint16_t frameNodes;
+	uint8_t frame;
+	uint8_t first;
+	uint8_t last;
+	uint8_t count;
+	uint8_t n;
+	uint8_t r;
+	
+	for (n = 0; n < nodes; n++)
+	{
+		if (nodeData[n].senCommand > active_int)
+		{
+			//receive_hue, receive_sat, receive_int and reset are not implemented
+			dirtyNodes &= ~(1 << n);
+		}
+	}
+	for (r = 0; r < radiosActive; r++)
+	{
+		last = ((r + 1) * nodesPerRadio < nodes) ? ((r + 1) * nodesPerRadio) : nodes;
+		for (frame = 0; frame < BROADCAST_FRAMES; frame++)
+		{
+			first = (r * nodesPerRadio) + (frame * BROADCAST_SLICES);
+			if (first >= last)
+			{
+				break;
+			}
+			count = ((last - first) < BROADCAST_SLICES) ? (last - first) : BROADCAST_SLICES;
+			frameNodes = ((1 << count) - 1) << first;
+		
+			if (!(dirtyNodes & frameNodes) && (++nodeKeepalive[first] < NODE_KEEPALIVE_TICKS))
+			{
+				continue;
+			}
+			if (nRF24_txBusy(&radio[r], frame))
+			{
+				//previous frame still in the air, the nodes stay dirty
+				continue;
+			}
+			p_frame = &broadcastSent[r][frame];
+			p_frame->header = RF_FRAME_HEADER(RF_FRAME_BROADCAST);
+			p_frame->destNode = BROADCAST_NODE;
+			p_frame->firstNode = first;
+			p_frame->nodeCount = count;
+			p_frame->seq = (dirtyNodes & frameNodes) ? trace_next_seq(&broadcastSeq) : RF_TRACE_NONE;
+			p_frame->stamp = dmx_buffer_stamp();
+			for (n = 0; n < count; n++)
+			{
+				if (nodeData[first + n].senCommand <= active_int)
+				{
+					nodeShadow[first + n] = nodeData[first + n];
+				}
+				p_node = &nodeShadow[first + n];
+				p_frame->slice[n].senCommand = p_node->senCommand;
+				p_frame->slice[n].hue = p_node->hue;
+				p_frame->slice[n].saturation = p_node->saturation;
+				p_frame->slice[n].intensity = p_node->intensity;
+			}
+#ifdef _DEBUG_
+		eventlog_write(EV_BROADCAST, EVENTLOG_BYTES(first + 1, first + count, 0, 0), 0);
+#endif
+			//only the valid slices go on air (dynamic payload length)
+			PROFILE_BEGIN(PROF_NRF_QUEUE);
+			nRF24_txQueue(&radio[r], frame, broadcastPipe, p_frame, sizeof(struct broadcastStruct) - ((BROADCAST_SLICES - count) * sizeof(struct nodeSlice)), true);
+			PROFILE_END(PROF_NRF_QUEUE);
+			nodeShadowValid |= frameNodes;
+			nodeKeepalive[first] = 0;
+		}
+	}
+}
+
+/**
+ * \brief nRF24 TX callback of the broadcast frames
+ * Broadcast frames carry no ACK payload, only the time from Art-Net arrival to the frame on air is recorded.
+ */
+static void radio_broadcast_done(nrf24_t *dev, uint8_t slot, bool ack, uint8_t retries, const uint8_t *ack_payload, uint8_t ack_len)
+{
+	const struct broadcastStruct *p_frame;
+	uint32_t ul_us;
+	uint8_t n;
+	
+	//runs in the nRF24 IRQ interrupt, the slot is the frame of the radio
+	UNUSED(ack);
+	UNUSED(retries);
+	UNUSED(ack_payload);
+	UNUSED(ack_len);
+	if (slot == RF_ANNOUNCE_SLOT)
+	{
+		return;
+	}
+	p_frame = &broadcastSent[dev - radio][slot];
+	if (p_frame->seq == RF_TRACE_NONE)
+	{
+		return;
+	}
+	ul_us = latency_since_us(p_frame->stamp);
+	for (n = 0; n < p_frame->nodeCount; n++)
+	{
+		latency_record(p_frame->firstNode + n, ul_us);
+	}
+}
+#endif
+
+/**
+ * \brief Queue the next copy of the rfChannel announcement on the rendezvous channel
+ * Sent by radio[0] from RF_ANNOUNCE_SLOT, one copy per call while the previous one has left the slot.
+ */
+static void radio_announce_channel(void)
+{
+	struct channelStruct announce = {RF_FRAME_HEADER(RF_FRAME_CHANNEL), CHANNEL_NODE, nodesPerRadio};
+	
+	if ((rfAnnounceRepeat == 0) || nRF24_txBusy(&radio[0], RF_ANNOUNCE_SLOT))
+	{
+		return;
+	}
+	memcpy(announce.channel, rfChannel, sizeof(rfChannel));
+	if (nRF24_txQueue(&radio[0], RF_ANNOUNCE_SLOT, broadcastPipe, &announce, sizeof(announce) - (RF_RADIO_MAX - radiosActive), true))
+	{
+		rfAnnounceRepeat--;
+	}
+}
+
+static void artnetToCommand(bool burst)
+{
+	const uint8_t *dmx_data = dmx_buffer_read();
+	struct dataStruct nodeData[MAX_NODES];
+	struct dataStruct *p_node;
+	uint16_t dirtyNodes = 0;
+#ifndef RADIO_BROADCAST
+	uint8_t txCount = 0;
+	uint8_t txBudget = burst ? nodes : (RADIO_TX_BUDGET * radiosActive);
+	uint8_t n;
+#endif
 	uint8_t nodeFunction;
 	uint8_t currentNode = 0;
-	dataOut.srcNode = 0;
-	uint8_t masterData = artnet_data_buffer[artnetDmxAddress-1];
-	uint16_t i = artnetDmxAddress -1; //Array starts at 0 but Art-Net data array had the first data byte at 0
+	uint8_t masterData = dmx_data[0];
+	uint16_t i;
+	
+	PROFILE_BEGIN(PROF_ARTNET_CMD);
+#ifndef RADIO_BROADCAST
+	radio_tx_collect();
+#else
+	UNUSED(burst);
+#endif
 //masterNode data - takes 1 channel starting at n
 /*	if (masterData<=20){
 		Each node to itself 
@@ -158,124 +595,93 @@ static void artnetToCommand(void)
 */
 	currentNode++;	
 //slaveNode data - takes 4 channels starting from n+1
-	for(i = artnetDmxAddress; i < (artnetDmxAddress + (nodes * 4)); i++)
+	memset(nodeData, 0, sizeof(nodeData));
+	for(i = 1; i < (1 + (nodes * NODE_CHANNELS)); i++)
 	{
-		nodeFunction = artnet_data_buffer[i++]; //use i, then increment
-		dataOut.hue = artnet_data_buffer[i++];
-		dataOut.saturation = artnet_data_buffer[i++];
-		dataOut.intensity = artnet_data_buffer[i];
-#ifdef _DEBUG_
-	printf("Node %d | HSV %d, %d, %d\r\n", currentNode, dataOut.hue, dataOut.saturation, dataOut.intensity);
-#endif		
-		if (nodeFunction <= 30)
+		p_node = &nodeData[currentNode - 1];
+		nodeFunction = dmx_data[i++]; //use i, then increment
+		p_node->hue = dmx_data[i++];
+		p_node->saturation = dmx_data[i++];
+		p_node->intensity = dmx_data[i];
+		p_node->header = RF_FRAME_HEADER(RF_FRAME_DATA);
+		p_node->srcNode = 0;
+		p_node->destNode = currentNode;
+		p_node->senCommand = nodeFunctionToCommand(nodeFunction);
+		
+		//mark the node dirty when it differs from what was last transmitted, the trace fields do not count
+		if (!(nodeShadowValid & (1 << (currentNode - 1))) || memcmp(p_node, &nodeShadow[currentNode - 1], offsetof(struct dataStruct, seq)))
 		{
-			//disabled
-			nRF24_openWritingPipe(listeningPipes[currentNode]);
-			dataOut.destNode = currentNode;
-			dataOut.senCommand = disabled;
-			
-			if(!nRF24_write(&dataOut, sizeof(dataOut)))
-			{
-#ifdef _DEBUG_
-	printf("transmission failed\n\r");
-#endif
-			}
-			
-#ifdef _DEBUG_
-	printf("disable sensor node %d\r\n", currentNode);
-#endif			
+			dirtyNodes |= (1 << (currentNode - 1));
 		}
-		else if (nodeFunction >= 31 && nodeFunction <= 60)
+		currentNode++;
+	}//end for-loop
+	
+#ifdef RADIO_BROADCAST
+	radio_broadcast(nodeData, dirtyNodes);
+#else
+	//changed nodes are sent immediately, unchanged nodes only get a keepalive refresh
+	for (n = 0; (n < nodes) && (txCount < txBudget); n++)
+	{
+		currentNode = ((radioNextNode + n) % nodes) + 1;
+		p_node = &nodeData[currentNode - 1];
+		
+		if (!(dirtyNodes & (1 << (currentNode - 1))) && (++nodeKeepalive[currentNode - 1] < NODE_KEEPALIVE_TICKS))
 		{
-			//active_hue
-			nRF24_openWritingPipe(listeningPipes[currentNode]);
-			dataOut.destNode = currentNode;
-			dataOut.senCommand = active_hue;
-			
-			if(!nRF24_write(&dataOut, sizeof(dataOut)))
-			{
-				#ifdef _DEBUG_
-				printf("transmission failed\n\r");
-				#endif
-			}
-			
-#ifdef _DEBUG_
-	printf("Sensor active_hue node %d\r\n", currentNode);
-#endif
+			continue;
 		}
-		else if (nodeFunction >= 61 && nodeFunction <= 90)
+		if (p_node->senCommand > active_int)
 		{
-			//active_sat
-			nRF24_openWritingPipe(listeningPipes[currentNode]);
-			dataOut.destNode = currentNode;
-			dataOut.senCommand = active_sat;
-			
-			if(!nRF24_write(&dataOut, sizeof(dataOut)))
-			{
-				#ifdef _DEBUG_
-				printf("transmission failed\n\r");
-				#endif
-			}
-			
-#ifdef _DEBUG_
-	printf("Sensor active_sat node %d\r\n", currentNode);
-#endif
+			//receive_hue, receive_sat, receive_int and reset are not implemented
+			continue;
 		}
-		else if (nodeFunction >= 91 && nodeFunction <= 120)
-		{
-			//active_int
-			nRF24_openWritingPipe(listeningPipes[currentNode]);
-			dataOut.destNode = currentNode;
-			dataOut.senCommand = active_int;
-			
-			if(!nRF24_write(&dataOut, sizeof(dataOut)))
-			{
-				#ifdef _DEBUG_
-				printf("transmission failed\n\r");
-				#endif
-			}
-			
 #ifdef _DEBUG_
-	printf("Sensor active_int node %d\r\n", currentNode);
+	eventlog_write(EV_NODE, EVENTLOG_BYTES(currentNode, p_node->senCommand, p_node->hue, p_node->saturation), p_node->intensity);
 #endif
-		}
-		else if (nodeFunction >= 121 && nodeFunction <= 150)
+		if (nRF24_txBusy(node_radio(currentNode - 1), currentNode - 1))
 		{
-			//receive_hue
+			//previous transmission still in the air, the node stays dirty
+			continue;
 		}
-		if (nodeFunction >= 151 && nodeFunction <= 180)
+		txCount++;
+		radio_link_retries(currentNode - 1);
+		nodeSent[currentNode - 1] = *p_node;
+		if (dirtyNodes & (1 << (currentNode - 1)))
 		{
-			//receive_sat
+			nodeSent[currentNode - 1].seq = trace_next_seq(&nodeSeq[currentNode - 1]);
+			nodeSent[currentNode - 1].stamp = dmx_buffer_stamp();
 		}
-		if (nodeFunction >= 181 && nodeFunction <= 210)
-		{
-			//receive_int
-		}
-		if (nodeFunction >= 211)
-		{
-			//reset
-		}
-		
-		currentNode++;
-	}//end for-loop
-	__enable_irq(); // Clear PRIMASK
-	//NVIC_EnableIRQ(GMAC_IRQn);
-
+		PROFILE_BEGIN(PROF_NRF_QUEUE);
+		nRF24_txQueue(node_radio(currentNode - 1), currentNode - 1, listeningPipes[currentNode], &nodeSent[currentNode - 1], sizeof(struct dataStruct), false);
+		PROFILE_END(PROF_NRF_QUEUE);
+	}
+	radioNextNode = (radioNextNode + n) % nodes;
+#endif
+	PROFILE_END(PROF_ARTNET_CMD);
 }
 
 int main (void)
 {
+	uint8_t rfSurvey[NRF24_CHANNELS];
+	uint32_t spiClock;
+	uint8_t r;
+	
 	/* Insert system clock initialization code here (sysclk_init()). */
 	sysclk_init();
 	board_init();
+	latency_initialize();
+#ifdef PROFILE_ENABLE
+	profile_initialize();
+#endif
 	
 	/* Initialize the console UART. */
 	configure_console();
 	puts(STRING_HEADER);
+	eventlog_initialize();
 
 	//functies zijn overbodig omdat feedback niet gegeven kan worden
 	fill_ArtNode(&ArtNode);
-	//fill_ArtPollReply(&ArtPollReply, &ArtNode);	
+	universe_routes_init();
+	build_ArtPollReply_frame();
 
 	if (!init_gmac_ethernet())
 	{
@@ -295,25 +701,135 @@ int main (void)
 #endif
 
 	spi_master_initialize();
-	nRF24_begin();
-	nRF24_setPALevel(RF_PA_HIGH);
-	nRF24_stopListening();
+	for (r = 0; r < RADIO_COUNT; r++)
+	{
+		if (!nRF24_begin(&radio[r]))
+		{
+			if (r > 0)
+			{
+				//radio not fitted
+				break;
+			}
+			//no readback to calibrate against, radio 0 stays on the slowest SPI clock
+		}
+		else
+		{
+			spiClock = nRF24_calibrateSpi(&radio[r]);
+#ifdef _DEBUG_
+			printf("-- Radio %d: SPI %lu Hz\r\n", r, (unsigned long)spiClock);
+#else
+			UNUSED(spiClock);
+#endif
+		}
+		nRF24_setPALevel(&radio[r], RF_PA_HIGH);
+		nRF24_enableDynamicPayloads(&radio[r]);
+		nRF24_stopListening(&radio[r]);
+		nRF24_enableDynamicAck(&radio[r]);
+	}
+	radiosActive = r;
+	nodesPerRadio = (nodes + radiosActive - 1) / radiosActive;
 	
+	//move the radios to the quietest channels apart from each other and tell the slaves
+	rfChannel[0] = nRF24_surveyChannels(&radio[0], rfSurvey, RF_SURVEY_SWEEPS);
+	nRF24_setChannel(&radio[0], rfChannel[0]); //the survey leaves it on the rendezvous channel, the announcement slot keeps that one
+	for (r = 1; r < radiosActive; r++)
+	{
+		rfChannel[r] = nRF24_pickChannel(rfSurvey, rfChannel, r, RF_CHANNEL_SPACING);
+		nRF24_setChannel(&radio[r], rfChannel[r]);
+	}
+	
+	for (r = 0; r < radiosActive; r++)
+	{
+#ifdef _DEBUG_
+		printf("-- Radio %d: RF channel %d, nodes %d-%d\r\n", r, rfChannel[r], (r * nodesPerRadio) + 1, min((r + 1) * nodesPerRadio, nodes));
+#endif
+#ifdef RADIO_BROADCAST
+		nRF24_txInit(&radio[r], radio_broadcast_done);
+#else
+		nRF24_enableAckPayload(&radio[r]);
+		nRF24_txInit(&radio[r], radio_tx_done);
+#endif
 #ifdef _DEBUG_
-	printDetails();
-#endif	
+		printDetails(&radio[r]);
+#endif
+	}
+	nRF24_txSetChannel(&radio[0], RF_ANNOUNCE_SLOT, RF_RENDEZVOUS_CHANNEL);
+	rfAnnounceRepeat = RF_ANNOUNCE_REPEAT;
+	radio_announce_channel();
+	
+	tc_radio_initialize(RADIO_OUTPUT_RATE);
+	
+	uint16_t us_frame_idx;
+	gmac_quelist_t e_frame_queue;
+	uint8_t *p_uc_frame;
+	bool b_dmx_received = false;
+	bool b_radio_tick;
+	bool b_frame;
 	
 	while(1)
 	{
-		// Process packets
-		if (GMAC_OK == read_dev_gmac()) {
-			if (ul_frm_size_rx > 0) {
-				// Handle input frame
-				if(handleGMAC_Packet((uint8_t *) gs_uc_eth_buffer_rx, ul_frm_size_rx)){
-					artnetToCommand();
+		PROFILE_BEGIN(PROF_LOOP);
+		// Process packets queued by the GMAC interrupts, Art-Net first
+		while (1) {
+			if (gmac_rx_frame_get(GMAC_ARTNET_QUE, &us_frame_idx)) {
+				e_frame_queue = GMAC_ARTNET_QUE;
+			}
+			else if (gmac_rx_frame_get(GMAC_QUE_0, &us_frame_idx)) {
+				e_frame_queue = GMAC_QUE_0;
+			}
+			else {
+				break;
+			}
+			PROFILE_BEGIN(PROF_ETH_RX);
+			b_frame = (GMAC_OK == peek_dev_gmac(e_frame_queue, us_frame_idx, &p_uc_frame));
+			PROFILE_END(PROF_ETH_RX);
+			if (b_frame && (ul_frm_size_rx > 0)) {
+				// Handle input frame in place in the RX ring
+				PROFILE_BEGIN(PROF_PACKET);
+				if(handleGMAC_Packet(p_uc_frame, ul_frm_size_rx)){
+					b_dmx_received = true;
 				}//end handle 
-			}//end of framesize
-		}//end read_GMAC
+				PROFILE_END(PROF_PACKET);
+			}//end peek_GMAC
+			// a broken frame is given back as well, it would hold its descriptors until the next frame
+			release_dev_gmac(e_frame_queue);
+		}//end of queue
+		
+		// Radio output runs at a fixed rate on the latest DMX frame, an ArtSync sends it right away
+		b_radio_tick = tc_radio_tick();
+		if (b_radio_tick) {
+			PROFILE_BEGIN(PROF_RADIO_POLL);
+			for (r = 0; r < radiosActive; r++) {
+				nRF24_txPoll(&radio[r]);
+			}
+			PROFILE_END(PROF_RADIO_POLL);
+			if (++rfAnnounceTicks >= RF_ANNOUNCE_TICKS) {
+				rfAnnounceTicks = 0;
+				rfAnnounceRepeat = RF_ANNOUNCE_REPEAT;
+			}
+			radio_announce_channel();
+		}
+		if (b_radio_tick && artSyncMode && (++artSyncTicks >= ARTSYNC_TIMEOUT_TICKS)) {
+			artsync_timeout();
+		}
+		if (artSyncCommit) {
+			artSyncCommit = false;
+			artnetToCommand(true);
+		}
+		else if (b_radio_tick && b_dmx_received) {
+			artnetToCommand(false);
+		}
+		
+		// Hand the logged events to the console USART, printf is not used from here on
+		eventlog_drain();
+		PROFILE_END(PROF_LOOP);
+		
+		// Sleep until the next interrupt, PRIMASK closes the race with the RX callback and radio tick
+		__disable_irq();
+		if (!gmac_rx_frame_pending() && !tc_radio_tick_pending()) {
+			__WFI();
+		}
+		__enable_irq();
 	}//end of loop
 }//end of program
 
@@ -324,8 +840,8 @@ int main (void)
 	- Handle packetType -
 */
 bool handleGMAC_Packet(uint8_t *p_uc_data, uint32_t ul_size){
+	uint16_t stamp = latency_stamp();
 	p_ethernet_header_t p_eth = (p_ethernet_header_t) p_uc_data;
-	p_T_ArtPoll p_artPoll_packet = (p_T_ArtPoll) (p_uc_data + ETH_HEADER_SIZE + ETH_IP_HEADER_SIZE + ICMP_HEADER_SIZE);
 	p_T_ArtDmx p_artDmx_packet = (p_T_ArtDmx) (p_uc_data + ETH_HEADER_SIZE + ETH_IP_HEADER_SIZE + ICMP_HEADER_SIZE);
 	//p_T_ArtAddress p_artAdress_packet = (p_T_ArtAddress) (p_uc_data + ETH_HEADER_SIZE + ETH_IP_HEADER_SIZE + ICMP_HEADER_SIZE);
 	uint16_t eth_pkt_format = SWAP16(p_eth->et_protlen);
@@ -336,7 +852,7 @@ bool handleGMAC_Packet(uint8_t *p_uc_data, uint32_t ul_size){
 		if (p_ip->ip_p == IP_PROT_UDP){
 			/*Check on added Art-Net header*/
 #ifdef _DEBUG_
-	printf("M: UDP\r\n");
+	eventlog_write(EV_UDP, ul_size, 0);
 #endif
 /************************************************************************/
 /* Controle op Art-Net anders uitvoeren                                 */
@@ -352,36 +868,53 @@ bool handleGMAC_Packet(uint8_t *p_uc_data, uint32_t ul_size){
 						return 0;
 					}
 					else{*/
+						//only copy the channels patched to the master and slave nodes
+						uint16_t port_address = ((uint16_t)(p_artDmx_packet->Net & 0x7F) << 8) | p_artDmx_packet->SubUni;
+						uint16_t dmx_length = SWAP16(p_artDmx_packet->Length);
+						
 #ifdef _DEBUG_
-	printf("M: DMX\r\n");
+	eventlog_write(EV_DMX, EVENTLOG_HALVES(port_address, dmx_length), 0);
 #endif
-						if(p_artDmx_packet->SubUni == ArtNode.swout[0])
+						if (dmx_length > MaxDataLength){
+							return 0;
+						}
+						//the data is read in place in the RX ring, a frame shorter than its Length would pull in stale ring data
+						if (ul_size < hdr_len + offsetof(T_ArtDmx, Data) + dmx_length){
+							return 0;
+						}
+						if(dmx_patch_universe(port_address, p_artDmx_packet->Data, dmx_length))
 						{
-							//memcpy (artnet_data_buffer, (uint8_t *)packet->Data, MaxDataLength);
-							memcpy(artnet_data_buffer, p_artDmx_packet->Data, SWAP16(p_artDmx_packet->Length)); //mempcy(dst, src, arraylength);
-							//printf("M: DMX saved\r\n");
+							dmx_image_stamp = stamp;
+							if(!artSyncMode)
+							{
+								memcpy(dmx_buffer_write(), dmx_node_image, DMX_IMAGE_SIZE); //mempcy(dst, src, arraylength);
+								dmx_buffer_publish(stamp);
+								//printf("M: DMX saved\r\n");
+							}
 						}
 					//}
 				}
+				else if(PacketType == ARTNET_SYNC){
+#ifdef _DEBUG_
+	eventlog_write(EV_ARTSYNC, 0, 0);
+#endif
+					//publish the staged frames, the main loop sends them in one burst
+					artSyncMode = true;
+					artSyncTicks = 0;
+					memcpy(dmx_buffer_write(), dmx_node_image, DMX_IMAGE_SIZE);
+					dmx_buffer_publish(stamp);
+					artSyncCommit = true;
+				}
 				else if(PacketType == ARTNET_POLL){
 					/*if(sizeof(packetBuffer) < sizeof(T_ArtPoll)){ 
 						return 0;
 					}
 					else{*/
 #ifdef _DEBUG_
-	printf("M: ArtPoll\r\n");
+	eventlog_write(EV_ARTPOLL, 0, 0);
 #endif
 						//handle_poll(p_artPoll_packet, p_uc_data);
-						if((p_artPoll_packet->Flags & 8) == 1) // controller say: send unicast reply
-						{
-							//send_reply(UNICAST, p_uc_data, (uint8_t *)&ArtPollReply);
-							//printf("M: ArtPollReply Unicast\r\n");
-						}
-						else // controller say: send broadcast reply
-						{
-							//send_reply(BROADCAST, p_uc_data, (uint8_t *)&ArtPollReply);
-							//printf("M: ArtPollReply Broadcast\r\n");
-						}
+						send_reply(ARTPOLLREPLY_MODE, p_uc_data);
 						return 0;
 					//}
 				} 
@@ -401,6 +934,12 @@ bool handleGMAC_Packet(uint8_t *p_uc_data, uint32_t ul_size){
 						return 0;
 					//}
 				}
+				else if(PacketType == ARTNET_COMMAND){
+					if(ul_size >= hdr_len + offsetof(T_ArtCommand, Data)){
+						handle_command((T_ArtCommand *) (p_uc_data + hdr_len), p_uc_data);
+					}
+					return 0;
+				}
 			}
 		}
 		else if(p_ip->ip_p == IP_PROT_ICMP)
@@ -415,7 +954,7 @@ bool handleGMAC_Packet(uint8_t *p_uc_data, uint32_t ul_size){
 	}
 	else{
 #ifdef _DEBUG_
-	printf("=== Default w_pkt_format= 0x%X===\n\r", eth_pkt_format);
+	eventlog_write(EV_ETH_FORMAT, eth_pkt_format, 0);
 #endif
 		return 0;	
 	}
@@ -479,11 +1018,10 @@ void fill_ArtNode(T_ArtNode *node)
 	node->swremote   = 0;
 	node->style      = 0;        // StNode style - A DMX to/from Art-Net device
 }
-/*
 void fill_ArtPollReply(T_ArtPollReply *poll_reply, T_ArtNode *node)
 {
 	//fill to 0's
-	memset (poll_reply, 0, sizeof(poll_reply));
+	memset (poll_reply, 0, sizeof(*poll_reply));
 	
 	//copy data from node
 	memcpy (poll_reply->ID, node->id, sizeof(poll_reply->ID));
@@ -491,16 +1029,13 @@ void fill_ArtPollReply(T_ArtPollReply *poll_reply, T_ArtNode *node)
 	memcpy (poll_reply->Mac, node->mac, sizeof(poll_reply->Mac));
 	memcpy (poll_reply->ShortName, node->shortname, sizeof(poll_reply->ShortName));
 	memcpy (poll_reply->LongName, node->longname, sizeof(poll_reply->LongName));
-	memcpy (poll_reply->NodeReport, node->nodereport, sizeof(poll_reply->NodeReport));
 	memcpy (poll_reply->PortTypes, node->porttypes, sizeof(poll_reply->PortTypes));
 	memcpy (poll_reply->GoodInput, node->goodinput, sizeof(poll_reply->GoodInput));
 	memcpy (poll_reply->GoodOutputA, node->goodoutput, sizeof(poll_reply->GoodOutputA));
 	memcpy (poll_reply->SwIn, node->swin, sizeof(poll_reply->SwIn));
 	memcpy (poll_reply->SwOut, node->swout, sizeof(poll_reply->SwOut));
-	memcpy (poll_reply->EstaManHi, node->etsamanH, sizeof(poll_reply->EstaManHi));
-	memcpy (poll_reply->EstaManLo, node->etsamanL, sizeof(poll_reply->EstaManLo));
 	
-	sprintf((char *)poll_reply->NodeReport, "%i nRF output universe active.\0", node->numbports);
+	snprintf((char *)poll_reply->NodeReport, sizeof(poll_reply->NodeReport), "%i nRF output universe active.", node->numbports);
 	
 	poll_reply->OpCode = 0x2100;  // ARTNET_REPLY
 	poll_reply->BoxAddr.Port = node->localPort;
@@ -511,18 +1046,86 @@ void fill_ArtPollReply(T_ArtPollReply *poll_reply, T_ArtNode *node)
 	poll_reply->OemHi = node->oemH;
 	poll_reply->OemLo = node->oem;
 	poll_reply->Status = node->status;
+	poll_reply->EstaManHi = node->etsamanH;
+	poll_reply->EstaManLo = node->etsamanL;
 	poll_reply->NumPortsHi = node->numbportsH;
 	poll_reply->NumPortsLo = node->numbports;
 	poll_reply->SwMacro         = node->swmacro;
 	poll_reply->SwRemote        = node->swremote;
 	poll_reply->Style           = node->style;
 } 
-*/
+
+/**
+ * \brief IPv4 header checksum, the result is stored as is in ip_sum
+ */
+static uint16_t ip_header_checksum(p_ip_header_t p_ip)
+{
+	uint16_t *p_word = (uint16_t *) p_ip;
+	uint32_t ul_sum = 0;
+	uint8_t i;
+	
+	p_ip->ip_sum = 0;
+	for (i = 0; i < (ETH_IP_HEADER_SIZE / 2); i++) {
+		ul_sum += p_word[i];
+	}
+	ul_sum = (ul_sum & 0xffff) + (ul_sum >> 16);
+	ul_sum = (ul_sum & 0xffff) + (ul_sum >> 16);
+	return (uint16_t) ~ul_sum;
+}
+
+/**
+ * \brief Build the ArtPollReply frame once at boot
+ * The reported ports follow universePatch, only the destination is filled in by send_reply().
+ */
+void build_ArtPollReply_frame(void)
+{
+	p_ethernet_header_t p_eth = (p_ethernet_header_t) artPollReplyFrame;
+	p_ip_header_t p_ip = (p_ip_header_t) (artPollReplyFrame + ETH_HEADER_SIZE);
+	p_udp_header_t p_udp = (p_udp_header_t) (artPollReplyFrame + ETH_HEADER_SIZE + ETH_IP_HEADER_SIZE);
+	p_T_ArtPollReply p_artPR = (p_T_ArtPollReply) (artPollReplyFrame + ETH_HEADER_SIZE + ETH_IP_HEADER_SIZE + UDP_HEADER_SIZE);
+	uint8_t i;
+	
+	//report the patched universes, an ArtPollReply holds up to 4 ports of one Net and SubNet
+	ArtNode.subH = (universePatch[0].portAddress >> 8) & 0x7F;
+	ArtNode.sub = (universePatch[0].portAddress >> 4) & 0x0F;
+	ArtNode.numbports = 0;
+	for (i = 0; (i < UNIVERSE_PATCHES) && (ArtNode.numbports < 4); i++) {
+		if ((universePatch[i].portAddress & 0x7FF0) == (universePatch[0].portAddress & 0x7FF0)) {
+			ArtNode.swout[ArtNode.numbports++] = universePatch[i].portAddress & 0x0F;
+		}
+	}
+	fill_ArtPollReply(p_artPR, &ArtNode);
+	
+	memset(artPollReplyFrame, 0, ETH_HEADER_SIZE + ETH_IP_HEADER_SIZE + UDP_HEADER_SIZE);
+	memcpy(p_eth->et_src, gs_uc_mac_address, sizeof(p_eth->et_src));
+	p_eth->et_protlen = SWAP16(ETH_PROT_IPV4);
+	
+	p_ip->ip_hl_v = 0x45;
+	p_ip->ip_len = SWAP16((ETH_IP_HEADER_SIZE + UDP_HEADER_SIZE + sizeof(T_ArtPollReply)));
+	p_ip->ip_ttl = 64;
+	p_ip->ip_p = IP_PROT_UDP;
+	memcpy(p_ip->ip_src, gs_uc_ip_address, sizeof(p_ip->ip_src));
+	
+	p_udp->udp_srcp = SWAP16(DefaultPortArt);
+	p_udp->udp_destp = SWAP16(DefaultPortArt);
+	p_udp->udp_len = SWAP16((UDP_HEADER_SIZE + sizeof(T_ArtPollReply)));
+	p_udp->udp_sum = 0; //optional for UDP over IPv4
+}
+
+/**
+ * \brief GMAC TX callback, the ArtPollReply frame may be patched again
+ */
+static void artPollReply_sent(uint32_t ul_status)
+{
+	UNUSED(ul_status);
+	artPollReplyBusy = false;
+}
+
 void handle_address(p_T_ArtAddress *packet, uint8_t *p_uc_data) //Not properly implemented yet
 {
-	send_reply(UNICAST, p_uc_data, (uint8_t *)&ArtPollReply);
+	send_reply(UNICAST, p_uc_data);
 #ifdef _DEBUG_
-	printf("M: Address unicast\r\n");
+	eventlog_write(EV_ADDRESS, 0, 0);
 #endif
 }
 
@@ -535,60 +1138,206 @@ T_ArtPacketType get_packet_type(uint8_t *packet) //this get artnet packet type
 	return 0;  // bad packet
 }
 
-void send_reply(uint8_t mode_broadcast, uint8_t *p_uc_data, uint8_t *packet)
+/**
+ * \brief Send the prebuilt ArtPollReply frame
+ * Only the destination and the IP checksum are patched, the frame is sent in place.
+ * A poll arriving while the previous reply is still queued is not answered, controllers poll again.
+ *
+ * \param mode_broadcast BROADCAST to the directed broadcast address, UNICAST to the sender of p_uc_data
+ * \param p_uc_data Received ArtPoll (or ArtAddress) frame
+ */
+void send_reply(uint8_t mode_broadcast, uint8_t *p_uc_data)
 {
 	uint8_t ul_rc = GMAC_OK;
-	uint32_t ul_size;
-	uint8_t i;
-	p_ethernet_header_t p_eth = (p_ethernet_header_t) p_uc_data;
-	p_ip_header_t p_ip = (p_ip_header_t) (p_uc_data + ETH_HEADER_SIZE);
-	p_udp_header_t p_udp = (p_udp_header_t) (p_uc_data + ETH_HEADER_SIZE + ETH_IP_HEADER_SIZE);
-	p_T_ArtPollReply p_artPR = (p_T_ArtPollReply) (p_uc_data + ETH_HEADER_SIZE + ETH_IP_HEADER_SIZE + UDP_HEADER_SIZE);
+	p_ethernet_header_t p_eth_rx = (p_ethernet_header_t) p_uc_data;
+	p_ip_header_t p_ip_rx = (p_ip_header_t) (p_uc_data + ETH_HEADER_SIZE);
+	p_ethernet_header_t p_eth = (p_ethernet_header_t) artPollReplyFrame;
+	p_ip_header_t p_ip = (p_ip_header_t) (artPollReplyFrame + ETH_HEADER_SIZE);
 	
-	//Swap ethernet [MAC] source and destination address
-	for (i = 0; i < 6; i++) {
-		p_eth->et_dest[i] = p_eth->et_src[i];
-		p_eth->et_src[i] = gs_uc_mac_address[i];
+	if (artPollReplyBusy && gmac_dev_get_tx_load(&gs_gmac_dev, GMAC_QUE_0)) {
+		return;
 	}
 	
-	//merge ArtPollReply into GMAC data
-	memcpy(p_artPR, packet, sizeof(T_ArtPollReply));//dest, src, len
+	if(mode_broadcast == BROADCAST) // send broadcast packet
+	{
+		memset(p_eth->et_dest, 0xFF, sizeof(p_eth->et_dest));
+		memcpy(p_ip->ip_dst, ArtNode.broadcastIp, sizeof(p_ip->ip_dst));
+	}
+	else // send unicast packet to controller
+	{
+		memcpy(p_eth->et_dest, p_eth_rx->et_src, sizeof(p_eth->et_dest));
+		memcpy(p_ip->ip_dst, p_ip_rx->ip_src, sizeof(p_ip->ip_dst));
+	}
+	p_ip->ip_sum = ip_header_checksum(p_ip);
 	
-	p_udp->udp_len = sizeof(T_ArtPollReply);
+	//the GMAC reads the frame from memory, push it out of the data cache
+	SCB_CleanDCache_by_Addr((uint32_t *) artPollReplyFrame, sizeof(artPollReplyFrame));
 	
-	//calculate size of the GMAC macket
-	ul_size = ETH_HEADER_SIZE + ETH_IP_HEADER_SIZE + UDP_HEADER_SIZE + sizeof(T_ArtPollReply);
+	artPollReplyBusy = true;
+	ul_rc = gmac_dev_write_static(&gs_gmac_dev, GMAC_QUE_0, artPollReplyFrame, ARTPOLLREPLY_FRAME_SIZE, artPollReply_sent);
+	if (ul_rc != GMAC_OK)
+	{
+		artPollReplyBusy = false;
+	}
 	
-	if(mode_broadcast == 1) // send broadcast packet
+#ifdef _DEBUG_
+	if (ul_rc != GMAC_OK)
 	{
-		//Fill in source IP address
-		for (i = 0; i < 4; i++) {
-			p_ip->ip_dst[i] = 255;
-			p_ip->ip_src[i] = gs_uc_ip_address[i];
-		}
-		ul_rc = gmac_dev_write(&gs_gmac_dev, *p_uc_data, GMAC_QUE_0, ul_size, NULL);
+	eventlog_write(EV_ARTPOLLREPLY_ERR, ul_rc, 0);
 	}
-	else // send unicast packet to controller
+	else
 	{
-		//Fill in source IP address
-		for (i = 0; i < 4; i++) {
-			p_ip->ip_dst[i] =p_ip->ip_src[i];
-			p_ip->ip_src[i] = gs_uc_ip_address[i];
-		}
-		ul_rc = gmac_dev_write(&gs_gmac_dev, *p_uc_data, GMAC_QUE_0, ul_size, NULL);
+	eventlog_write(EV_ARTPOLLREPLY, 0, 0);
 	}
+#endif
 	
+}
+
+/**
+ * \brief Handle an ArtCommand, only the latency trace and profile commands are implemented
+ * "Latency&" is answered with the latency report, "LatencyReset&" clears the histograms.
+ * "Profile&" and "ProfileHist&" are answered with the profile probes, "ProfileReset&" clears them.
+ *
+ * \param p_command Received ArtCommand
+ * \param p_uc_data Received frame
+ */
+void handle_command(T_ArtCommand *p_command, uint8_t *p_uc_data)
+{
+	const char *p_text = (const char *) p_command->Data;
+	uint16_t length = SWAP16(p_command->Length);
+	
+	if (length > MaxDataLength)
+	{
+		return;
+	}
+	if ((length >= strlen("LatencyReset&")) && !strncmp(p_text, "LatencyReset&", strlen("LatencyReset&")))
+	{
+		latency_reset();
+#ifdef _DEBUG_
+	eventlog_write(EV_LATENCY_RESET, 0, 0);
+#endif
+	}
+	else if ((length >= strlen("Latency&")) && !strncmp(p_text, "Latency&", strlen("Latency&")))
+	{
+		send_diag_report(p_uc_data, DIAG_REPORT_LATENCY);
+	}
+#ifdef PROFILE_ENABLE
+	else if ((length >= strlen("ProfileReset&")) && !strncmp(p_text, "ProfileReset&", strlen("ProfileReset&")))
+	{
+		profile_reset();
 #ifdef _DEBUG_
+	eventlog_write(EV_PROFILE_RESET, 0, 0);
+#endif
+	}
+	else if ((length >= strlen("ProfileHist&")) && !strncmp(p_text, "ProfileHist&", strlen("ProfileHist&")))
+	{
+		send_diag_report(p_uc_data, DIAG_REPORT_PROFILE_HIST);
+	}
+	else if ((length >= strlen("Profile&")) && !strncmp(p_text, "Profile&", strlen("Profile&")))
+	{
+		send_diag_report(p_uc_data, DIAG_REPORT_PROFILE);
+	}
+#endif
+}
+
+/**
+ * \brief GMAC TX callback, the diag report frame may be written again
+ */
+static void diagReport_sent(uint32_t ul_status)
+{
+	UNUSED(ul_status);
+	diagReportBusy = false;
+}
+
+/**
+ * \brief Send a report as ArtDiagData text to the sender of p_uc_data
+ * A request arriving while the previous report is still queued is not answered.
+ *
+ * \param p_uc_data Received ArtCommand frame
+ * \param report DIAG_REPORT_LATENCY, DIAG_REPORT_PROFILE or DIAG_REPORT_PROFILE_HIST
+ */
+void send_diag_report(uint8_t *p_uc_data, uint8_t report)
+{
+	uint8_t ul_rc = GMAC_OK;
+	p_ethernet_header_t p_eth_rx = (p_ethernet_header_t) p_uc_data;
+	p_ip_header_t p_ip_rx = (p_ip_header_t) (p_uc_data + ETH_HEADER_SIZE);
+	p_ethernet_header_t p_eth = (p_ethernet_header_t) diagReportFrame;
+	p_ip_header_t p_ip = (p_ip_header_t) (diagReportFrame + ETH_HEADER_SIZE);
+	p_udp_header_t p_udp = (p_udp_header_t) (diagReportFrame + ETH_HEADER_SIZE + ETH_IP_HEADER_SIZE);
+	T_ArtDiagData *p_diag = (T_ArtDiagData *) (diagReportFrame + ETH_HEADER_SIZE + ETH_IP_HEADER_SIZE + UDP_HEADER_SIZE);
+	uint16_t length;
+	
+	if (diagReportBusy && gmac_dev_get_tx_load(&gs_gmac_dev, GMAC_QUE_0)) {
+		return;
+	}
+	
+	//null terminated text, the terminator is part of the Length
+	switch (report)
+	{
+#ifdef PROFILE_ENABLE
+		case DIAG_REPORT_PROFILE:
+		case DIAG_REPORT_PROFILE_HIST:
+			length = profile_report((char *) p_diag->Data, DIAG_REPORT_SIZE, report == DIAG_REPORT_PROFILE_HIST) + 1;
+			break;
+#endif
+		default:
+#ifdef RADIO_BROADCAST
+			//broadcast frames carry no ACK payload, the samples lack the slave receive to FastLED.show() time
+			length = snprintf((char *) p_diag->Data, DIAG_REPORT_SIZE, "Master side only: Art-Net to on air\n");
+			length += latency_report((char *) p_diag->Data + length, DIAG_REPORT_SIZE - length, nodes) + 1;
+#else
+			length = latency_report((char *) p_diag->Data, DIAG_REPORT_SIZE, nodes) + 1;
+#endif
+			break;
+	}
+	memcpy(p_diag->ID, ArtNode.id, sizeof(p_diag->ID));
+	p_diag->OpCode = ARTNET_DIAGDATA;
+	p_diag->ProtVerHi = ArtNode.ProVerH;
+	p_diag->ProtVerLo = ArtNode.ProVer;
+	p_diag->Filler1 = 0;
+	p_diag->DiagPriority = DpLow;
+	p_diag->LogicalPort = 0;
+	p_diag->Filler3 = 0;
+	p_diag->Length = SWAP16(length);
+	
+	memset(diagReportFrame, 0, ETH_HEADER_SIZE + ETH_IP_HEADER_SIZE + UDP_HEADER_SIZE);
+	memcpy(p_eth->et_dest, p_eth_rx->et_src, sizeof(p_eth->et_dest));
+	memcpy(p_eth->et_src, gs_uc_mac_address, sizeof(p_eth->et_src));
+	p_eth->et_protlen = SWAP16(ETH_PROT_IPV4);
+	
+	p_ip->ip_hl_v = 0x45;
+	p_ip->ip_len = SWAP16((ETH_IP_HEADER_SIZE + UDP_HEADER_SIZE + offsetof(T_ArtDiagData, Data) + length));
+	p_ip->ip_ttl = 64;
+	p_ip->ip_p = IP_PROT_UDP;
+	memcpy(p_ip->ip_src, gs_uc_ip_address, sizeof(p_ip->ip_src));
+	memcpy(p_ip->ip_dst, p_ip_rx->ip_src, sizeof(p_ip->ip_dst));
+	p_ip->ip_sum = ip_header_checksum(p_ip);
+	
+	p_udp->udp_srcp = SWAP16(DefaultPortArt);
+	p_udp->udp_destp = SWAP16(DefaultPortArt);
+	p_udp->udp_len = SWAP16((UDP_HEADER_SIZE + offsetof(T_ArtDiagData, Data) + length));
+	p_udp->udp_sum = 0; //optional for UDP over IPv4
+	
+	//the GMAC reads the frame from memory, push it out of the data cache
+	SCB_CleanDCache_by_Addr((uint32_t *) diagReportFrame, sizeof(diagReportFrame));
+	
+	diagReportBusy = true;
+	ul_rc = gmac_dev_write_static(&gs_gmac_dev, GMAC_QUE_0, diagReportFrame, DIAG_FRAME_HEADER + length, diagReport_sent);
 	if (ul_rc != GMAC_OK)
 	{
-	printf("E: ArtPollReply not send");
+		diagReportBusy = false;
+	}
+	
+#ifdef _DEBUG_
+	if (ul_rc != GMAC_OK)
+	{
+	eventlog_write(EV_DIAG_REPORT_ERR, EVENTLOG_BYTES(report, ul_rc, 0, 0), 0);
 	}
 	else
 	{
-	printf("M: ArtPollReply send\r\n");
+	eventlog_write(EV_DIAG_REPORT, report, 0);
 	}
 #endif
-	
 }
 
 /// @cond 0
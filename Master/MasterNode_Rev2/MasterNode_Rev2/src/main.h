@@ -9,13 +9,19 @@
 #ifndef MAIN_H_
 #define MAIN_H_
 
-#define _DEBUG_
+//#define RADIO_BROADCAST //send all nodes in one broadcast frame instead of one acknowledged dataStruct per node, without ACKs: no sensor uplink, link retries or slave latency
+#define LATENCY_TRACE //trace Art-Net to LED latency
 
 #include "softLib/GMAC_Artnet.h"
 #include "softLib/ArtNet/Art-Net.h"
 #include "softLib/nRF24.h"
 #include "softLib/nRF24L01.h"
 #include "softLib/SAM_SPI.h"
+#include "softLib/SAM_TC.h"
+#include "softLib/latency.h"
+#include "softLib/eventLog.h"
+#include "radioFrame.h" //Slave/libraries/radioFrame, shared with the slave sketches
+#include "profile.h" //Master/libraries/profile, probes in config/conf_profile.h
 
 
 
@@ -85,7 +91,10 @@ typedef enum artnet_packet_type_e {
 	FAULTY_PACKET = 0x0000,
 	ARTNET_POLL = 0x2000,
 	ARTNET_REPLY = 0x2100,
+	ARTNET_DIAGDATA = 0x2300,
+	ARTNET_COMMAND = 0x2400,
 	ARTNET_DMX = 0x5000,
+	ARTNET_SYNC = 0x5200,
 	ARTNET_ADDRESS = 0x6000,
 	ARTNET_INPUT = 0x7000,
 	ARTNET_TODREQUEST = 0x8000,
@@ -115,46 +124,185 @@ T_ArtPacketType get_packet_type(uint8_t *packet);
 void fill_ArtNode(T_ArtNode *node);
 void fill_ArtPollReply(T_ArtPollReply *poll_reply, T_ArtNode *node);
 void handle_address(p_T_ArtAddress *packet, uint8_t *p_uc_data);
-void send_reply(uint8_t mode_broadcast, uint8_t *p_uc_data, uint8_t *packet);
+void build_ArtPollReply_frame(void);
+void send_reply(uint8_t mode_broadcast, uint8_t *p_uc_data);
+void handle_command(T_ArtCommand *p_command, uint8_t *p_uc_data);
+void send_diag_report(uint8_t *p_uc_data, uint8_t report);
+void universe_routes_init(void);
+bool dmx_patch_universe(uint16_t portAddress, const uint8_t *data, uint16_t length);
+uint8_t *dmx_buffer_write(void);
+void dmx_buffer_publish(uint16_t stamp);
+const uint8_t *dmx_buffer_read(void);
+uint16_t dmx_buffer_stamp(void);
 
 /************************************************************************/
 /* Global variables                                                     */
 /************************************************************************/
-typedef enum sensorCommand{
-  disabled = 0,
-  active_hue,
-  active_sat,
-  active_int, 
-  receive_hue,
-  receive_sat,
-  receive_int,
-  reset
-}e_command;
-
 /* Datapaket standaard.
-   datapaketten verzonden binnen dit project zullen dit formaat hanteren om een uniform systeem te vormen
-   srcNode    //Enumeration van de node waar de data van origineerd
-   destNode   //Enumeration van de node waar deze data voor bestemd is.
-   command      //commando (Enum) gestuctureerd volgens command table
-   intensity    //intensity of the LEDs
-   hue          //color of the LEDs transcoded in a hue
-   saturation   //saturation of the colors
-   sensorval    //sensor values to use in calculations sigend (8-bit, value tussen -128 tot 127)
+   datapaketten verzonden binnen dit project hanteren de frames van radioFrame.h (dataStruct, sensorStruct,
+   broadcastStruct, channelStruct): vaste byte offsets en een versie/type header byte, gedeeld met de slaves.
 */
-struct dataStruct {
-  uint8_t srcNode;
-  uint8_t destNode;
-  e_command senCommand;
-  uint8_t intensity;
-  uint8_t hue;
-  uint8_t saturation;
-  int8_t sensorVal;
-} dataIn, dataOut;
-
-static const uint32_t listeningPipes[6] = {0x3A3A3AA1UL, 0x3A3A3AB1UL, 0x3A3A3AC1UL, 0x3A3A3AD1UL, 0x3A3A3AE1UL, 0x3A3A3A0A}; //unieke adressen gebruikt door de nodes.
-static uint16_t artnetDmxAddress = 1;
+struct dataStruct dataIn, dataOut;
+
+#define MAX_NODES               8
+#define NODE_CHANNELS           4 //function, hue, saturation, dimmer
+static const uint32_t listeningPipes[MAX_NODES + 1] = {0x3A3A3AA1UL, 0x3A3A3AB1UL, 0x3A3A3AC1UL, 0x3A3A3AD1UL, 0x3A3A3AE1UL, 0x3A3A3AF1UL, 0x3A3A3A01UL, 0x3A3A3A11UL, 0x3A3A3A21UL}; //unieke adressen gebruikt door de nodes.
 static const uint8_t nodes = 2; //number of sensor nodes
 
+/* Universe patch.
+   Every entry maps a block of consecutive nodes onto one universe, following the channel map of artnetToCommand().
+   portAddress  15 bit Art-Net Port-Address: Net (bit 14-8), SubNet (bit 7-4), Universe (bit 3-0)
+   dmxAddress   DMX address of channel n, the nodes take 4 channels each starting from n+1
+   firstNode    first node (0 = slave node 1) of the block
+   nodeCount    number of nodes in the block */
+typedef struct universe_patch_s {
+	uint16_t portAddress;
+	uint16_t dmxAddress;
+	uint8_t  firstNode;
+	uint8_t  nodeCount;
+} T_UniversePatch;
+
+static const T_UniversePatch universePatch[] = {
+	{0x0000, 1, 0, 2},
+};
+#define UNIVERSE_PATCHES        (sizeof(universePatch) / sizeof(universePatch[0]))
+
+/* Universe routing table, built from universePatch by universe_routes_init().
+   universeBitmap has one bit per Port-Address to reject unpatched universes in O(1),
+   universeRoute is a small open addressed hash from Port-Address to universePatch index. */
+#define PORT_ADDRESSES          0x8000
+#define UNIVERSE_ROUTE_SLOTS    16 //power of two, larger than UNIVERSE_PATCHES
+#define UNIVERSE_ROUTE_EMPTY    0xFF
+//the linear probes stop at an empty slot, at least one must stay free
+_Static_assert(UNIVERSE_PATCHES < UNIVERSE_ROUTE_SLOTS, "UNIVERSE_ROUTE_SLOTS must be larger than UNIVERSE_PATCHES");
+uint32_t universeBitmap[PORT_ADDRESSES / 32];
+uint8_t universeRoute[UNIVERSE_ROUTE_SLOTS];
+
+/* Radio output scheduler.
+   The latest DMX frame is sent RADIO_OUTPUT_RATE times per second (slaves pace their frames at ~40Hz),
+   with at most RADIO_TX_BUDGET node transmissions per radio and tick.
+   The budget is what one radio gets through in a tick when every transmission needs all its retries
+   (RADIO_TX_WORST_US, the slowest setting of radio_link_retries()), so a tick never queues more
+   than the radios can send before the next one. It only limits setups with more nodes per radio. */
+#define RADIO_OUTPUT_RATE       40
+#define RADIO_TX_WORST_US       ((5 + 1) * 1000) //ARD 1ms, 5 retries
+#define RADIO_TX_BUDGET         ((1000000 / RADIO_OUTPUT_RATE) / RADIO_TX_WORST_US)
+#if RADIO_TX_BUDGET < 1
+#error "RADIO_OUTPUT_RATE leaves no time for a transmission"
+#endif
+uint8_t radioNextNode; //first node served on the next tick
+
+/* ArtSync.
+   After an ArtSync the master stages ArtDmx frames in dmx_node_image and only publishes them on the next ArtSync,
+   which sends every changed node in one burst. Without ArtSync for ARTSYNC_TIMEOUT_TICKS radio ticks (4s, Art-Net 4)
+   the master falls back to publishing every ArtDmx frame immediately. */
+#define ARTSYNC_TIMEOUT_TICKS   (4 * RADIO_OUTPUT_RATE)
+bool artSyncMode;
+bool artSyncCommit; //set by an ArtSync, cleared when the burst is sent
+uint16_t artSyncTicks; //radio ticks since the last ArtSync
+
+/* Shadow of the last dataStruct transmitted to every node.
+   Nodes whose data did not change are only refreshed every NODE_KEEPALIVE_TICKS radio ticks. */
+#define NODE_KEEPALIVE_TICKS    40
+struct dataStruct nodeShadow[MAX_NODES];
+uint16_t nodeShadowValid; //bit n set when nodeShadow[n] was transmitted
+uint8_t nodeKeepalive[MAX_NODES]; //ticks since the last transmission
+
+/* Radios.
+   The master drives RADIO_COUNT nRF24 radios on SPI0, every radio on its own RF channel.
+   Node n (0 based) is served by radio[n / nodesPerRadio], so the radios refresh their nodes in parallel.
+   radio[0]     EXT1: NPCS1 (PD25), CE PC9, IRQ PD28
+   radio[1]     EXT2: NPCS3 (PD27), CE PD11 (GPIO_1), IRQ PA2
+   A radio that does not answer at boot is dropped, its nodes move to the radios before it. */
+#define RADIO_COUNT             2
+#if RADIO_COUNT > NRF24_MAX_DEVICES
+#error "more radios than the nRF24 driver supports"
+#endif
+nrf24_t radio[RADIO_COUNT] = {
+	NRF24_DEVICE(1, PIO_PC9_IDX, D, PIO_PD28),
+	NRF24_DEVICE(3, PIO_PD11_IDX, A, PIO_PA2),
+};
+uint8_t radiosActive; //radio[0] to radio[radiosActive - 1] are in use
+uint8_t nodesPerRadio;
+
+/* Radio transmissions run in the background (nRF24_txQueue), one TX slot per node on the radio of the node.
+   nodeSent holds the dataStruct in the air, radio_tx_done() flags the result and
+   artnetToCommand() moves acknowledged nodes into nodeShadow. */
+#if MAX_NODES + 1 > NRF24_TX_SLOTS
+#error "every node needs its own nRF24 TX slot, plus one for the channel announcement"
+#endif
+struct dataStruct nodeSent[MAX_NODES];
+volatile uint16_t nodeTxAcked; //bit n set when nodeSent[n] was acknowledged
+volatile uint16_t nodeTxFailed; //bit n set when nodeSent[n] was dropped after the retries
+
+/* Link quality per node.
+   nodeLinkRetries is a running average of the retransmissions (ARC_CNT) per payload in 1/16,
+   a dropped payload counts as LINK_LOST_RETRIES. artnetToCommand() picks the retry delay (ARD) and
+   count (ARC) of every node from it: good links retry fast and few times, bad links get a capped
+   budget so one far node cannot use up the radio tick. */
+#define LINK_AVG_SHIFT          2 //weight of a new sample: 1/4
+#define LINK_LOST_RETRIES       15
+#define LINK_GOOD               (1 * 16) //below 1 retransmission per payload
+#define LINK_FAIR               (4 * 16) //below 4 retransmissions per payload
+volatile uint8_t nodeLinkRetries[MAX_NODES];
+
+/* Latency trace (LATENCY_TRACE).
+   Every DMX buffer carries the latency_stamp() of the Art-Net frame it was published from. Nodes that changed
+   are sent with the next trace sequence number (nodeSeq) and that stamp, keepalive refreshes go untraced.
+   Unicast: radio_tx_done() keeps the time from Art-Net arrival to the ACK of every traced frame in nodeTrace,
+   the slave reports the time from receiving that frame to the end of FastLED.show() in a later ACK payload
+   and the sum of both goes into the histogram of the node.
+   Broadcast frames have no ACK payload, only the time from Art-Net arrival to the frame on air is recorded,
+   with RADIO_BROADCAST the first line of the report says so.
+   The stamps come from a free running TC channel (LATENCY_TC), so the trace also holds while the main loop sleeps.
+   An ArtCommand "Latency&" is answered with an ArtDiagData text report, "LatencyReset&" clears the histograms. */
+#if MAX_NODES > LATENCY_NODES
+#error "every node needs its own latency histogram"
+#endif
+uint8_t nodeSeq[MAX_NODES]; //last trace sequence number per node (unicast)
+uint8_t broadcastSeq; //last trace sequence number of the broadcast frames
+struct nodeTrace_s {
+	uint8_t seq; //traced frame acknowledged by the node
+	uint32_t air_us; //Art-Net arrival to ACK of that frame
+};
+struct nodeTrace_s nodeTrace[MAX_NODES]; //only used by the nRF24 IRQ
+
+/* Sensor uplink.
+   Every slave preloads its latest sensor value as ACK payload, so each acknowledged dataStruct
+   returns it without extra airtime (not available with RADIO_BROADCAST, broadcast frames are not acknowledged).
+   The frame is struct sensorStruct of radioFrame.h. */
+volatile int8_t nodeSensor[MAX_NODES]; //latest sensorVal per node
+volatile uint16_t nodeSensorFresh; //bit n set when nodeSensor[n] was updated
+
+/* Broadcast frame.
+   With RADIO_BROADCAST the master sends the command and HSV of every node in one frame without ACK
+   (W_TX_PAYLOAD_NO_ACK) to broadcastPipe, every slave keeps the slice of its own localAddr.
+   The frame is struct broadcastStruct of radioFrame.h, nodes beyond BROADCAST_SLICES follow in a next frame. */
+#define BROADCAST_FRAMES        ((MAX_NODES + BROADCAST_SLICES - 1) / BROADCAST_SLICES)
+static const uint32_t broadcastPipe = 0x3A3A3A00UL; //shares the upper bytes with listeningPipes (slave pipe 4)
+struct broadcastStruct broadcastSent[RADIO_COUNT][BROADCAST_FRAMES];
+
+/* RF channel.
+   At boot the master surveys all channels (RPD) and moves every radio to the quietest channel at least
+   RF_CHANNEL_SPACING away from the channels of the other radios. The channels are announced by radio[0]
+   to broadcastPipe on RF_RENDEZVOUS_CHANNEL at boot and every RF_ANNOUNCE_TICKS radio ticks,
+   slaves that lose the master return to the rendezvous channel to pick it up again.
+   The announcement is queued in TX slot RF_ANNOUNCE_SLOT with its own channel, one of the RF_ANNOUNCE_REPEAT
+   copies per radio tick, so it shares the air with the node payloads instead of blocking the main loop.
+   The frame is struct channelStruct of radioFrame.h, only radiosActive channels are sent (dynamic payload length). */
+#define RF_RENDEZVOUS_CHANNEL   76
+#define RF_SURVEY_SWEEPS        40 //~1s
+#define RF_ANNOUNCE_TICKS       (2 * RADIO_OUTPUT_RATE)
+#define RF_ANNOUNCE_REPEAT      3
+#define RF_ANNOUNCE_SLOT        MAX_NODES //TX slot of radio[0] after the nodes
+#define RF_CHANNEL_SPACING      10 //co-located radios, keep them clear of each other's sidebands
+#if RADIO_COUNT > RF_RADIO_MAX
+#error "the channel announcement holds RF_RADIO_MAX radios"
+#endif
+uint8_t rfChannel[RADIO_COUNT];
+uint16_t rfAnnounceTicks;
+uint8_t rfAnnounceRepeat; //copies of the announcement still to queue
+
 uint8_t factory_mac [6] = {ETHERNET_CONF_ETHADDR0, ETHERNET_CONF_ETHADDR1, ETHERNET_CONF_ETHADDR2, ETHERNET_CONF_ETHADDR3, ETHERNET_CONF_ETHADDR4, ETHERNET_CONF_ETHADDR5};
 uint8_t factory_localIp [4] = {ETHERNET_CONF_IPADDR0, ETHERNET_CONF_IPADDR1, ETHERNET_CONF_IPADDR2, ETHERNET_CONF_IPADDR3};
 uint8_t factory_broadcastIp  [4] = {ETHERNET_CONF_IPADDR0, 255, 255, 255};           // broadcast IP address
@@ -163,10 +311,46 @@ uint8_t factory_subnetMask   [4] = {ETHERNET_CONF_NET_MASK0, ETHERNET_CONF_NET_M
 
 uint8_t factory_swin         [4] = {   0,   1,   2,   3};
 uint8_t factory_swout        [4] = {   0,   1,   2,   3};
-uint8_t artnet_data_buffer[512];
+
+/* Triple buffered DMX store.
+   The network side fills dmx_write_idx, the radio side reads dmx_read_idx and both
+   exchange their buffer with dmx_shared_idx atomically, so neither side has to mask interrupts.
+   DMX_FRESH is set in dmx_shared_idx when it holds a frame the radio side has not seen yet.
+   The buffers only hold the patched channels: channel n followed by NODE_CHANNELS per node.
+   dmx_node_image is the network side copy all universes are merged into. */
+#define DMX_BUFFERS	3
+#define DMX_FRESH	0x80
+#define DMX_IMAGE_SIZE	(1 + (MAX_NODES * NODE_CHANNELS))
+uint8_t artnet_dmx_buffer[DMX_BUFFERS][DMX_IMAGE_SIZE];
+uint16_t artnet_dmx_stamp[DMX_BUFFERS]; //latency_stamp() of the Art-Net frame published in the buffer
+uint8_t dmx_node_image[DMX_IMAGE_SIZE];
+uint16_t dmx_image_stamp; //latency_stamp() of the last Art-Net frame merged into dmx_node_image
+uint8_t dmx_write_idx = 0;
+uint8_t dmx_read_idx = 2;
+volatile uint8_t dmx_shared_idx = 1;
 
 T_ArtNode ArtNode;
 T_ArtPollReply ArtPollReply;
 T_ArtPacketType PacketType;
 
+/* ArtPollReply frame (Ethernet, IP, UDP and ArtPollReply) built once by build_ArtPollReply_frame().
+   send_reply() only patches the destination and the IP checksum and sends the frame in place,
+   artPollReplyBusy is set until the GMAC has sent it.
+   Art-Net 4 sends ArtPollReply as directed broadcast, ARTPOLLREPLY_MODE UNICAST answers the poller only
+   (for networks that drop broadcasts). The ArtPoll Flags do not select this. */
+#define ARTPOLLREPLY_MODE       BROADCAST
+#define ARTPOLLREPLY_FRAME_SIZE	(ETH_HEADER_SIZE + ETH_IP_HEADER_SIZE + UDP_HEADER_SIZE + sizeof(T_ArtPollReply))
+COMPILER_ALIGNED(32) uint8_t artPollReplyFrame[ARTPOLLREPLY_FRAME_SIZE];
+volatile bool artPollReplyBusy;
+
+/* ArtDiagData frame carrying a text report, sent by send_diag_report() to the sender of the ArtCommand.
+   diagReportBusy is set until the GMAC has sent it. */
+#define DIAG_REPORT_LATENCY     0 //latency histograms per node ("Latency&")
+#define DIAG_REPORT_PROFILE     1 //profile probes, summary ("Profile&")
+#define DIAG_REPORT_PROFILE_HIST 2 //profile probes, log2 histograms ("ProfileHist&")
+#define DIAG_REPORT_SIZE     512
+#define DIAG_FRAME_HEADER    (ETH_HEADER_SIZE + ETH_IP_HEADER_SIZE + UDP_HEADER_SIZE + offsetof(T_ArtDiagData, Data))
+COMPILER_ALIGNED(32) uint8_t diagReportFrame[DIAG_FRAME_HEADER + DIAG_REPORT_SIZE];
+volatile bool diagReportBusy;
+
 #endif /* MAIN_H_ */
\ No newline at end of file
@@ -7,11 +7,7 @@
 
 #include "GMAC_Artnet.h"
 #include "softLib/ArtNet/Art-Net.h"
-
-uint32_t read_dev_gmac(void)
-{
-	return gmac_dev_read(&gs_gmac_dev, GMAC_QUE_0, (uint8_t *) gs_uc_eth_buffer_rx, sizeof(gs_uc_eth_buffer_rx), &ul_frm_size_rx);
-}
+#include "softLib/eventLog.h"
 
 /**
  * \brief Send ulLength bytes from pcFrom. This copies the buffer to one of the
@@ -39,10 +35,6 @@ uint8_t gs_uc_mac_address[] =
 uint8_t gs_uc_ip_address[] =
 { ETHERNET_CONF_IPADDR0, ETHERNET_CONF_IPADDR1, ETHERNET_CONF_IPADDR2, ETHERNET_CONF_IPADDR3 };
 
-/* Art-Net identification string*/
-static uint8_t artnet_id[] =
-{0x41, 0x72, 0x74, 0x2D, 0x4E, 0x65, 0x74, 0x00}; // ascii for "Art-Net"
-
 /** The GMAC driver instance */
 gmac_device_t gs_gmac_dev;
 
@@ -50,15 +42,40 @@ gmac_device_t gs_gmac_dev;
 volatile uint8_t gs_uc_eth_buffer_rx[GMAC_FRAME_LENTGH_MAX];
 volatile uint8_t gs_uc_eth_buffer_tx[GMAC_FRAME_LENTGH_MAX];
 
-/** Buffer for Artnet DMX data */
-volatile uint8_t artnet_data_buffer[512];
-//uint8_t artnet_data_buffer[512];
-
 uint32_t ul_frm_size_rx, ul_frm_size_tx;
 volatile uint32_t ul_delay;
 gmac_options_t gmac_option;
 T_Addr p_artAddr;
-T_ArtPollReply p_artPollReply_packet;
+
+#if (GMAC_RX_FRAME_QUEUE_SIZE & (GMAC_RX_FRAME_QUEUE_SIZE - 1))
+#error "GMAC_RX_FRAME_QUEUE_SIZE must be a power of two"
+#endif
+
+/** Marker for "no start of frame seen yet" while scanning the RX ring */
+#define GMAC_RX_NO_SOF	0xFFFF
+
+/**
+ * Single-producer/single-consumer queue of received frames, one per GMAC queue.
+ * The GMAC interrupt is the only writer of us_head, the main context the only
+ * writer of us_tail, so no locking is required. Both counters run freely and
+ * are masked on access.
+ * us_scan_count is raised by the interrupt and lowered by the main context with
+ * the interrupts masked, it keeps the scan from lapping descriptors it already queued.
+ */
+typedef struct gmac_rx_frame_queue {
+	volatile uint16_t us_head;
+	volatile uint16_t us_tail;
+	uint16_t us_idx[GMAC_RX_FRAME_QUEUE_SIZE];
+	/** Next RX descriptor to be inspected by the interrupt */
+	uint16_t us_scan_idx;
+	/** Descriptor holding the start of the frame currently being scanned */
+	uint16_t us_scan_sof;
+	/** Descriptors scanned by the interrupt and not yet given back to the GMAC */
+	volatile uint16_t us_scan_count;
+} gmac_rx_frame_queue_t;
+
+/** Indexed by gmac_quelist_t, only GMAC_QUE_0 and GMAC_ARTNET_QUE are used */
+static gmac_rx_frame_queue_t gs_rx_frame_queue[GMAC_ARTNET_QUE + 1];
 
 static uint16_t gmac_icmp_checksum(uint16_t *p_buff, uint32_t ul_len)
 {
@@ -73,6 +90,160 @@ static uint16_t gmac_icmp_checksum(uint16_t *p_buff, uint32_t ul_len)
 	return (uint16_t) (~ul_tmp);
 }
 
+/**
+ * \brief Walk the RX descriptors released by the GMAC since the last call and
+ * queue the start descriptor index of every complete frame for the main context.
+ * The walk stops at the first descriptor owned by the GMAC, or when every descriptor
+ * of the ring is scanned and waits for the main context. A frame that does not fit
+ * in a full frame queue is left out, peek_dev_gmac() of a later frame drops it.
+ *
+ * \param queue_idx GMAC queue whose RX ring is scanned.
+ */
+static void gmac_rx_frame_scan(gmac_quelist_t queue_idx)
+{
+	gmac_queue_t *p_gmac_queue = &gs_gmac_dev.gmac_queue_list[queue_idx];
+	gmac_rx_frame_queue_t *p_frame_queue = &gs_rx_frame_queue[queue_idx];
+	gmac_rx_descriptor_t *p_rx_td = &p_gmac_queue->p_rx_dscr[p_frame_queue->us_scan_idx];
+	uint16_t us_head = p_frame_queue->us_head;
+
+	while (((p_rx_td->addr.val & GMAC_RXD_OWNERSHIP) == GMAC_RXD_OWNERSHIP) &&
+			(p_frame_queue->us_scan_count < p_gmac_queue->us_rx_list_size)) {
+		if (p_rx_td->status.val & GMAC_RXD_SOF) {
+			p_frame_queue->us_scan_sof = p_frame_queue->us_scan_idx;
+		}
+		if ((p_rx_td->status.val & GMAC_RXD_EOF) && (p_frame_queue->us_scan_sof != GMAC_RX_NO_SOF)) {
+			if ((uint16_t)(us_head - p_frame_queue->us_tail) < GMAC_RX_FRAME_QUEUE_SIZE) {
+				p_frame_queue->us_idx[us_head & (GMAC_RX_FRAME_QUEUE_SIZE - 1)] = p_frame_queue->us_scan_sof;
+				us_head++;
+			}
+			p_frame_queue->us_scan_sof = GMAC_RX_NO_SOF;
+		}
+		p_frame_queue->us_scan_count++;
+
+		if (++p_frame_queue->us_scan_idx >= p_gmac_queue->us_rx_list_size) {
+			p_frame_queue->us_scan_idx = 0;
+		}
+		p_rx_td = &p_gmac_queue->p_rx_dscr[p_frame_queue->us_scan_idx];
+	}
+
+	/* Publish the entries only after they are written */
+	__DMB();
+	p_frame_queue->us_head = us_head;
+}
+
+/**
+ * \brief Account for the RX descriptors the main context gave back to the GMAC.
+ *
+ * \param queue_idx GMAC queue of the descriptors.
+ * \param us_old_idx us_rx_idx of the GMAC queue before the descriptors were given back.
+ */
+static void gmac_rx_frame_returned(gmac_quelist_t queue_idx, uint16_t us_old_idx)
+{
+	gmac_queue_t *p_gmac_queue = &gs_gmac_dev.gmac_queue_list[queue_idx];
+	uint16_t us_count = (p_gmac_queue->us_rx_idx + p_gmac_queue->us_rx_list_size - us_old_idx) % p_gmac_queue->us_rx_list_size;
+	irqflags_t flags;
+
+	if (us_count == 0) {
+		return;
+	}
+	flags = cpu_irq_save();
+	gs_rx_frame_queue[queue_idx].us_scan_count -= us_count;
+	//frames that came in while the ring was full raised no new interrupt
+	gmac_rx_frame_scan(queue_idx);
+	cpu_irq_restore(flags);
+}
+
+/**
+ * \brief RX complete callback of GMAC_QUE_0, runs in GMAC interrupt context.
+ *
+ * \param ul_status RX status flags reported by gmac_handler().
+ */
+static void gmac_rx_frame_callback(uint32_t ul_status)
+{
+	UNUSED(ul_status);
+	gmac_rx_frame_scan(GMAC_QUE_0);
+}
+
+/**
+ * \brief RX complete callback of GMAC_ARTNET_QUE, runs in GMAC priority queue interrupt context.
+ *
+ * \param ul_status RX status flags reported by gmac_handler().
+ */
+static void gmac_rx_artnet_callback(uint32_t ul_status)
+{
+	UNUSED(ul_status);
+	gmac_rx_frame_scan(GMAC_ARTNET_QUE);
+}
+
+/**
+ * \brief Fetch the next received frame from the RX frame queue of a GMAC queue.
+ * The frame itself is still in the GMAC RX ring and is read with peek_dev_gmac().
+ *
+ * \param queue_idx GMAC_ARTNET_QUE or GMAC_QUE_0.
+ * \param p_us_idx RX descriptor index of the start of the frame.
+ *
+ * \return true if a frame was dequeued.
+ */
+bool gmac_rx_frame_get(gmac_quelist_t queue_idx, uint16_t *p_us_idx)
+{
+	gmac_rx_frame_queue_t *p_frame_queue = &gs_rx_frame_queue[queue_idx];
+	uint16_t us_tail = p_frame_queue->us_tail;
+
+	if (us_tail == p_frame_queue->us_head) {
+		return false;
+	}
+	*p_us_idx = p_frame_queue->us_idx[us_tail & (GMAC_RX_FRAME_QUEUE_SIZE - 1)];
+
+	/* Release the slot only after it has been read */
+	__DMB();
+	p_frame_queue->us_tail = us_tail + 1;
+	return true;
+}
+
+/**
+ * \brief Check whether the GMAC interrupts queued frames that have not been read.
+ */
+bool gmac_rx_frame_pending(void)
+{
+	return (gs_rx_frame_queue[GMAC_ARTNET_QUE].us_tail != gs_rx_frame_queue[GMAC_ARTNET_QUE].us_head) ||
+		(gs_rx_frame_queue[GMAC_QUE_0].us_tail != gs_rx_frame_queue[GMAC_QUE_0].us_head);
+}
+
+/**
+ * \brief Borrow a received frame from a GMAC RX ring without copying it.
+ * gs_uc_eth_buffer_rx is only used when the frame wraps around the ring.
+ * The frame must be handed back with release_dev_gmac().
+ *
+ * \param queue_idx GMAC_ARTNET_QUE or GMAC_QUE_0.
+ * \param us_idx RX descriptor index of the start of the frame, from gmac_rx_frame_get().
+ * \param pp_frame Returns the address of the frame, its size is in ul_frm_size_rx.
+ *
+ * \return GMAC_OK if a frame is available.
+ */
+uint32_t peek_dev_gmac(gmac_quelist_t queue_idx, uint16_t us_idx, uint8_t **pp_frame)
+{
+	uint16_t us_rx_idx = gs_gmac_dev.gmac_queue_list[queue_idx].us_rx_idx;
+	uint32_t ul_rc;
+
+	ul_rc = gmac_dev_rx_peek(&gs_gmac_dev, queue_idx, us_idx, pp_frame, (uint8_t *) gs_uc_eth_buffer_rx, sizeof(gs_uc_eth_buffer_rx), &ul_frm_size_rx);
+	gmac_rx_frame_returned(queue_idx, us_rx_idx);
+	return ul_rc;
+}
+
+/**
+ * \brief Give the frame read with peek_dev_gmac() back to the GMAC.
+ * Also called after a failed peek_dev_gmac(), the descriptors of a broken frame are dropped.
+ *
+ * \param queue_idx GMAC_ARTNET_QUE or GMAC_QUE_0.
+ */
+void release_dev_gmac(gmac_quelist_t queue_idx)
+{
+	uint16_t us_rx_idx = gs_gmac_dev.gmac_queue_list[queue_idx].us_rx_idx;
+
+	gmac_dev_rx_release(&gs_gmac_dev, queue_idx);
+	gmac_rx_frame_returned(queue_idx, us_rx_idx);
+}
+
 bool init_gmac_ethernet(void)
 {
 	#ifdef ETH_SUPPORT_AT24MAC
@@ -98,8 +269,20 @@ bool init_gmac_ethernet(void)
 	// Init GMAC driver structure
 	gmac_dev_init(GMAC, &gs_gmac_dev, &gmac_option);
 
-	// Enable Interrupt
+	// Steer Art-Net into its own queue, everything else stays on queue 0
+	gs_rx_frame_queue[GMAC_QUE_0].us_scan_sof = GMAC_RX_NO_SOF;
+	gs_rx_frame_queue[GMAC_ARTNET_QUE].us_scan_sof = GMAC_RX_NO_SOF;
+	gmac_dev_set_udp_screener(&gs_gmac_dev, 0, DefaultPortArt, GMAC_ARTNET_QUE);
+
+	// Receive frames through the RX complete interrupts
+	gmac_dev_set_rx_callback(&gs_gmac_dev, GMAC_QUE_0, gmac_rx_frame_callback);
+	gmac_dev_set_rx_callback(&gs_gmac_dev, GMAC_ARTNET_QUE, gmac_rx_artnet_callback);
+
+	// Enable Interrupt, Art-Net preempts the other traffic
+	NVIC_SetPriority(GMAC_IRQn, 2);
+	NVIC_SetPriority(GMAC_Q1_IRQn, 0);
 	NVIC_EnableIRQ(GMAC_IRQn);
+	NVIC_EnableIRQ(GMAC_Q1_IRQn);
 
 	// Init MAC PHY driver
 	if (ethernet_phy_init(GMAC, BOARD_GMAC_PHY_ADDR, sysclk_get_cpu_hz())
@@ -138,16 +321,9 @@ void gmac_process_arp_packet(uint8_t *p_uc_data, uint32_t ul_size)
 	p_arp_header_t p_arp = (p_arp_header_t) (p_uc_data + ETH_HEADER_SIZE);
 
 	if (SWAP16(p_arp->ar_op) == ARP_REQUEST) {
-		#ifdef _DEBUG_
-printf("-- MAC %x:%x:%x:%x:%x:%x\n\r",
-		p_eth->et_dest[0], p_eth->et_dest[1],
-		p_eth->et_dest[2], p_eth->et_dest[3],
-		p_eth->et_dest[4], p_eth->et_dest[5]);
-
-		printf("-- MAC %x:%x:%x:%x:%x:%x\n\r",
-		p_eth->et_src[0], p_eth->et_src[1],
-		p_eth->et_src[2], p_eth->et_src[3],
-		p_eth->et_src[4], p_eth->et_src[5]);
+#ifdef _DEBUG_
+		eventlog_write(EV_ARP_REQUEST, EVENTLOG_BYTES(p_eth->et_src[0], p_eth->et_src[1], p_eth->et_src[2], p_eth->et_src[3]),
+			p_eth->et_src[4] | (p_eth->et_src[5] << 8));
 #endif
 
 		/* ARP reply operation */
@@ -170,8 +346,8 @@ printf("-- MAC %x:%x:%x:%x:%x:%x\n\r",
 		ul_rc = gmac_dev_write(&gs_gmac_dev, GMAC_QUE_0, p_uc_data, ul_size, NULL);
 
 		if (ul_rc != GMAC_OK) {
-			#ifdef _DEBUG_
-printf("E: ARP Send - 0x%x\n\r", ul_rc);
+#ifdef _DEBUG_
+			eventlog_write(EV_ARP_SEND_ERR, ul_rc, 0);
 #endif
 		}
 	}
@@ -227,239 +403,13 @@ void gmac_process_ICMP_packet(uint8_t *p_uc_data, uint32_t ul_size)
 		SWAP16(p_ip_header->ip_len) + 14, NULL);
 		#endif
 		if (ul_rc != GMAC_OK) {
-			#ifdef _DEBUG_
-printf("E: ICMP Send - 0x%x\n\r", ul_rc);
+#ifdef _DEBUG_
+			eventlog_write(EV_ICMP_SEND_ERR, ul_rc, 0);
 #endif
 		}
 	}
 }
 
-/**
- * Function is from the example project and not further of service in this project
- * \brief Display the IP packet.
- *
- * \param p_ip_header Pointer to the IP header.
- * \param ul_size    The data size.
- */
-void gmac_display_ip_packet(p_ip_header_t p_ip_header, uint32_t ul_size)
-{
-	printf("======= IP %4d bytes, HEADER ==========\n\r", (int)ul_size);
-	printf(" IP Version        = v.%d", (p_ip_header->ip_hl_v & 0xF0) >> 4);
-	printf("\n\r Header Length     = %d", p_ip_header->ip_hl_v & 0x0F);
-	printf("\n\r Type of service   = 0x%x", p_ip_header->ip_tos);
-	printf("\n\r Total IP Length   = 0x%X",
-	(((p_ip_header->ip_len) >> 8) & 0xff) +
-	(((p_ip_header->ip_len) << 8) & 0xff00));
-	printf("\n\r ID                = 0x%X",
-	(((p_ip_header->ip_id) >> 8) & 0xff) +
-	(((p_ip_header->ip_id) << 8) & 0xff00));
-	printf("\n\r Header Checksum   = 0x%X",
-	(((p_ip_header->ip_sum) >> 8) & 0xff) +
-	(((p_ip_header->ip_sum) << 8) & 0xff00));
-	puts("\r Protocol          = ");
-
-	switch (p_ip_header->ip_p) {
-		case IP_PROT_ICMP:
-		puts("ICMP");
-		break;
-
-		case IP_PROT_IP:
-		puts("IP");
-		break;
-
-		case IP_PROT_TCP:
-		puts("TCP");
-		break;
-
-		case IP_PROT_UDP:
-		puts("UDP");
-		break;
-
-		default:
-		printf("%d (0x%X)", p_ip_header->ip_p, p_ip_header->ip_p);
-		break;
-	}
-
-	printf("\n\r IP Src Address    = %d:%d:%d:%d",
-	p_ip_header->ip_src[0],
-	p_ip_header->ip_src[1],
-	p_ip_header->ip_src[2], p_ip_header->ip_src[3]);
-
-	printf("\n\r IP Dest Address   = %d:%d:%d:%d",
-	p_ip_header->ip_dst[0],
-	p_ip_header->ip_dst[1],
-	p_ip_header->ip_dst[2], p_ip_header->ip_dst[3]);
-	puts("\n\r----------------------------------------\r");
-}
-
-static void display_ArtDmx_packet(p_T_ArtDmx p_ArtDmx_packet)
-{
-	printf("\n\r");
-	printf("identifier: %c%c%c%c%c%c%c%c\n\r", (char)p_ArtDmx_packet->ID[0], (char)p_ArtDmx_packet->ID[1], (char)p_ArtDmx_packet->ID[2], (char)p_ArtDmx_packet->ID[3], (char)p_ArtDmx_packet->ID[4], (char)p_ArtDmx_packet->ID[5], (char)p_ArtDmx_packet->ID[6], (char)p_ArtDmx_packet->ID[7]);
-	printf("Opcode: %X\n\r", p_ArtDmx_packet->OpCode);
-
-		for (long i = 0; i<512; i++)
-		{
-			printf("Channel %ld: %d\n\r", i+1, p_ArtDmx_packet->Data[i]);
-		}
-}
-
-static void gmac_process_artnet_packet(uint8_t *p_uc_data, uint32_t ul_size)
-{
-	int32_t ul_rc = GMAC_OK;
-	p_art_packet_t p_art_packet = (p_art_packet_t) (p_uc_data + ETH_HEADER_SIZE + ETH_IP_HEADER_SIZE + ICMP_HEADER_SIZE);
-	p_T_ArtPoll p_artPoll_packet = (p_T_ArtPoll) (p_uc_data + ETH_HEADER_SIZE + ETH_IP_HEADER_SIZE + ICMP_HEADER_SIZE);
-	p_T_ArtDmx p_artDmx_packet = (p_T_ArtDmx) (p_uc_data + ETH_HEADER_SIZE + ETH_IP_HEADER_SIZE + ICMP_HEADER_SIZE);
-	
-	//printf("OpCode = %X\n\r", p_art_packet->art_OpCode);
-	
-	switch (p_art_packet->art_OpCode)
-	{
-	case OpPoll:
-		for (uint8_t i = 0; i<8; i++)
-		{
-			p_artPollReply_packet.ID[i] = p_artPoll_packet->ID[i];
-		}
-		p_artPollReply_packet.OpCode = OpPollReply;
-		p_artPollReply_packet.BoxAddr = p_artAddr;
-		p_artPollReply_packet.VersionInfoLo = 0x01; //Version 1 of the firmware
-		//p_artPollReply_packet.NetSwitch = ;
-		//p_artPollReply_packet.SubSwitch = ;
-		//p_artPollReply_packet.OemHi = 0x00; //OEM Unknown 0x00FF
-		p_artPollReply_packet.OemLo = 0xFF;
-		//p_artPollReply_packet.UbeaVerion = 0x00; //Not programmed
-		p_artPollReply_packet.Status = 0b00000010;
-		p_artPollReply_packet.EstaManLo = "S";
-		p_artPollReply_packet.EstaManHi = "R";
-		strcpy (p_artPollReply_packet.ShortName, "MstrTX");
-		strcpy (p_artPollReply_packet.LongName, "Masternode for interactive theater system");
-		//p_artPollReply_packet.NodeReport = ;
-		//p_artPollReply_packet.NumPortsHi = 0;
-		p_artPollReply_packet.NumPortsLo = 0;
-		//p_artPollReply_packet.PortTypes[4] = {0, 0, 0, 0};
-		//p_artPollReply_packet.GoodInput[4] = {0, 0, 0, 0};
-		p_artPollReply_packet.GoodOutputA[0] = 0x80;
-		//p_artPollReply_packet.SwIn[4] = {};
-		//p_artPollReply_packet.SwOut[4] = {};
-		//p_artPollReply_packet.AcnPriority = ;
-		//p_artPollReply_packet.SwMacro = 0;
-		//p_artPollReply_packet.SwRemote = 0;
-		//p_artPollReply_packet.Spare1 = 0;
-		//p_artPollReply_packet.Spare2 = 0;
-		//p_artPollReply_packet.Spare3 = 0;
-		//p_artPollReply_packet.Style = 0; //StNode - A DMX to/from Art-Net device
-		
-		for (uint8_t i = 0; i < 6; i++)
-		{
-			p_artPollReply_packet.Mac[i] = gs_uc_mac_address[i];	
-		}
-		//p_artPollReply_packet.BindIp[4] = {};
-		//p_artPollReply_packet.BindIndex = 0;
-		//p_artPollReply_packet.Status2 = 0;
-		p_artPollReply_packet.GoodOutputB[0] = 0b11000000;
-		p_artPollReply_packet.Status3 = 0b010000000;
-		//p_artPollReply_packet.DefaultUiResponder = ;
-		//p_artPollReply_packet.Filler[15] = {};	
-		
-		//send ArtPollReply
-		
-		puts("ArtPoll replied\r");
-		break;
-	case OpDmx:
-		//printf("Universe: %d%d\n\r", p_artDmx_packet->Net, p_artDmx_packet->SubUni);
-		if (p_artDmx_packet->SubUni == 0 && p_artDmx_packet->Net == 0)
-		{
-			//Length is send LSB first an received byte swapped, for the correct length we have to re-swap it
-			memcpy(artnet_data_buffer, p_artDmx_packet->Data, SWAP16(p_artDmx_packet->Length)); //mempcy(dst, src, arraylength);
-			puts("DMX saved\r");
-			//display_ArtDmx_packet(p_artDmx_packet);
-		}
-		
-		break;
-	default:
-		puts("Unimplemented OpCode");
-		break;
-	}
-}
-
-/**
- * \brief Process the received IP packet; change address and send it back.
- *
- * \param p_uc_data  The data to process.
- * \param ul_size The data size.
- */
-static void gmac_process_ip_packet(uint8_t *p_uc_data, uint32_t ul_size)
-{
-	uint32_t i;
-	uint8_t controle[8];
-	uint32_t hdr_len = ETH_HEADER_SIZE + ETH_IP_HEADER_SIZE + ICMP_HEADER_SIZE;
-	
-	p_ip_header_t p_ip_header = (p_ip_header_t) (p_uc_data + ETH_HEADER_SIZE);
-	if (p_ip_header ->ip_p == IP_PROT_UDP)
-	{
-		//puts("UDP packet\r\n");
-		/*Check on added Art-Net header*/
-		if (ul_size > hdr_len)
-		{
-			/*Check if the 8 following bytes of the headers are part of the Art-Net header*/
-			for (i = 0; i < 8; i++)
-			{
-				controle[i] = p_uc_data[hdr_len+i];
-			}
-			/*Check if data read compares to "Art-Net"*/
-			if (!compareArray(controle, artnet_id, 8))
-			{	
-				//printf("Art-Net compatible\r");
-				gmac_process_artnet_packet(p_uc_data, ul_size);
-			}
-		}
-	}
-}
-
-/**
- * \brief Process the received GMAC packet.
- *
- * \param p_uc_data  The data to process.
- * \param ul_size The data size.
- */
-void gmac_process_eth_packet(uint8_t *p_uc_data, uint32_t ul_size)
-{
-	uint16_t us_pkt_format;
-
-	p_ethernet_header_t p_eth = (p_ethernet_header_t) (p_uc_data);
-	p_ip_header_t p_ip_header = (p_ip_header_t) (p_uc_data + ETH_HEADER_SIZE);
-	ip_header_t ip_header;
-	us_pkt_format = SWAP16(p_eth->et_protlen);
-
-	if (us_pkt_format == ETH_PROT_IPV4)
-	{
-		/* Backup the header */
-		//memcpy(&ip_header, p_ip_header, sizeof(ip_header_t)); //memcpy(dest, src, size)
-
-		/* Process the IP packet */
-		gmac_process_ip_packet(p_uc_data, ul_size);
-		// Dump the IP header
-		//gmac_display_ip_packet(&ip_header, ul_size);
-	}
-	else
-	{
-		printf("=== Default w_pkt_format= 0x%X===\n\r", us_pkt_format);
-	}
-}
-
-/*
-	Debugging purposes;
-	Function prints the whole Ethernet buffer to the terminal
-*/
-void display_eth_buffer(uint8_t *eth_buffer, uint32_t ul_size)
-{
-	uint32_t b_size;
-	for (b_size = 0; b_size < ul_size; b_size++)
-	{
-		printf("package %ld: %d\n\r", b_size, eth_buffer[b_size]);
-	}
-}
-
 #ifdef ETH_SUPPORT_AT24MAC
 void at24mac_get_mac_address(void)
 {
@@ -500,6 +450,14 @@ void GMAC_Handler(void)
 	gmac_handler(&gs_gmac_dev, GMAC_QUE_0);
 }
 
+/**
+ * \brief GMAC priority queue 1 interrupt handler (Art-Net).
+ */
+void GMAC_Q1_Handler(void)
+{
+	gmac_handler(&gs_gmac_dev, GMAC_ARTNET_QUE);
+}
+
 char compareArray(uint8_t a[],uint8_t b[],uint8_t size)	
 {
 	int i;
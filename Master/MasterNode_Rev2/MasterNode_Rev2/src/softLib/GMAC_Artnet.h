@@ -14,24 +14,31 @@
 #include "mini_ip.h"
 #include "conf_eth.h"
 
+/** GMAC queue receiving Art-Net (UDP port 6454), steered there by a type 1 screener.
+ *  All other traffic (ARP, ICMP, broadcasts) stays on GMAC_QUE_0. */
+#define GMAC_ARTNET_QUE	GMAC_RX_PRIORITY_QUEUE
+
+/** Size of the RX frame queues filled by the GMAC interrupts.
+ *  Every queued frame holds at least one RX descriptor, so a queue as large as
+ *  the largest descriptor ring can never overflow. Must be a power of two. */
+#define GMAC_RX_FRAME_QUEUE_SIZE	GMAC_RX_PRIORITY_BUFFERS
+
 extern uint8_t gs_uc_mac_address[];
 extern uint32_t ul_frm_size_rx, ul_frm_size_tx;
 extern gmac_device_t gs_gmac_dev;
 extern volatile uint8_t gs_uc_eth_buffer_rx[GMAC_FRAME_LENTGH_MAX];
 extern volatile uint8_t gs_uc_eth_buffer_tx[GMAC_FRAME_LENTGH_MAX];
-//extern volatile uint8_t artnet_data_buffer[512];
-//extern uint8_t artnet_data_buffer[512];
 extern uint8_t gs_uc_ip_address[];
 
-uint32_t read_dev_gmac(void);
+uint32_t peek_dev_gmac(gmac_quelist_t queue_idx, uint16_t us_idx, uint8_t **pp_frame);
+void release_dev_gmac(gmac_quelist_t queue_idx);
 uint32_t write_dev_gmac(void *p_buffer, uint32_t ul_size);
 bool init_gmac_ethernet(void);
+bool gmac_rx_frame_get(gmac_quelist_t queue_idx, uint16_t *p_us_idx);
+bool gmac_rx_frame_pending(void);
 void gmac_process_arp_packet(uint8_t *p_uc_data, uint32_t ul_size);
 void gmac_process_ICMP_packet(uint8_t *p_uc_data, uint32_t ul_size);
 void at24mac_get_mac_address(void);
-void gmac_display_ip_packet(p_ip_header_t p_ip_header, uint32_t ul_size);
-void gmac_process_eth_packet(uint8_t *p_uc_data, uint32_t ul_size);
-void display_eth_buffer(uint8_t *eth_buffer, uint32_t ul_size);
 char compareArray(uint8_t a[],uint8_t b[],uint8_t size);
 
 #endif /* GMAC_ARTNET_H_ */
\ No newline at end of file
@@ -11,22 +11,91 @@
 /* SPI clock default setting (Hz). */
 uint32_t gs_ul_spi_clock = 5000000;
 
+/* SPI clock configurations (Hz), slowest first. The nRF24L01+ is specified up to 10MHz. */
+static const uint32_t gs_ul_clock_configurations[NUM_SPCK_CONFIGURATIONS] = {2000000, 5000000, 7500000, 10000000};
+
+/* Delay before SPCK (DLYBS) and between consecutive transfers (DLYBCT), most conservative first. */
+static const uint8_t gs_uc_delay_configurations[NUM_DELAY_CONFIGURATIONS][2] = {
+	{SPI_DLYBS, SPI_DLYBCT},
+	{0x08, 0x01},
+	{0x02, 0x00},
+};
+
+/* DMA transfer state.
+   In variable peripheral select mode every TX word carries the data, the chip select (PCS) and LASTXFER,
+   the received bytes are written back into the buffer of the caller. */
+COMPILER_ALIGNED(SPI_DCACHE_LINE) static uint32_t spi_tx_word[SPI_LIST_MAX];
+static spi_list_t spi_xfer_list; // transfers in the air, their buffers are invalidated when done
+static spi_xfer_cb_t spi_xfer_callback;
+static void *spi_xfer_arg;
+static volatile bool spi_xfer_pending; // asynchronous transfer whose callback did not run yet
+
+/* Microblock control of a linked list descriptor (MBR_UBC) */
+#define XDMAC_UBC_NDE           (0x1u << 24) //fetch the next descriptor
+#define XDMAC_UBC_NDEN          (0x1u << 26) //update the destination address
+#define XDMAC_UBC_NVIEW_NDV1    (0x1u << 27) //next descriptor is a view 1 descriptor
+
+/* Linked list descriptor, view 1: one per transfer of a command list (RX channel) */
+typedef struct {
+	uint32_t mbr_nda; // next descriptor address
+	uint32_t mbr_ubc; // microblock control
+	uint32_t mbr_ta; // destination address
+} spi_xdmac_desc_t;
+
+COMPILER_ALIGNED(SPI_DCACHE_LINE) static spi_xdmac_desc_t spi_rx_desc[SPI_LIST_CMDS];
+
+/* NPCS pins of SPI0 and their peripheral function. */
+static const ioport_pin_t npcs_pin[] = {SPI0_NPCS0_GPIO, SPI0_NPCS1_GPIO, SPI0_NPCS2_GPIO, SPI0_NPCS3_GPIO};
+static const ioport_mode_t npcs_flags[] = {SPI0_NPCS0_FLAGS, SPI0_NPCS1_FLAGS, SPI0_NPCS2_FLAGS, SPI0_NPCS3_FLAGS};
+
 /**
- * \brief Set the specified SPI clock configuration.
+ * \brief Set the specified SPI clock configuration of a device.
+ * Waits for a running transfer, the new clock applies to the next transfer.
  *
+ * \param chip_sel Chip select of the device.
  * \param configuration  Index of the configuration to set.
+ *
+ * \return SPI clock (Hz).
  */
-static void spi_set_clock_configuration(uint8_t configuration)
+uint32_t spi_set_clock_configuration(uint8_t chip_sel, uint8_t configuration)
 {
-	//spi_disable_xdmac();
-	NVIC_ClearPendingIRQ(SPI_IRQn);
-	NVIC_DisableIRQ(SPI_IRQn);
-	NVIC_SetPriority(SPI_IRQn, 0);
-	NVIC_EnableIRQ(SPI_IRQn);
+	if (configuration >= NUM_SPCK_CONFIGURATIONS)
+	{
+		configuration = NUM_SPCK_CONFIGURATIONS - 1;
+	}
+	spi_master_wait();
+	spi_set_baudrate_div(SPI0, chip_sel, (sysclk_get_peripheral_hz() / gs_ul_clock_configurations[configuration]));
+	return spi_get_clock(chip_sel);
+}
 
-	#ifdef _DEBUG_
-printf("Setting SPI clock %lu Hz\n\r", (unsigned long)gs_ul_spi_clock);
-#endif
+/**
+ * \brief Set the specified chip select delay configuration of a device.
+ *
+ * \param chip_sel Chip select of the device.
+ * \param configuration  Index of the configuration to set.
+ */
+void spi_set_delay_configuration(uint8_t chip_sel, uint8_t configuration)
+{
+	if (configuration >= NUM_DELAY_CONFIGURATIONS)
+	{
+		configuration = NUM_DELAY_CONFIGURATIONS - 1;
+	}
+	spi_master_wait();
+	spi_set_transfer_delay(SPI0, chip_sel, gs_uc_delay_configurations[configuration][0], gs_uc_delay_configurations[configuration][1]);
+}
+
+/**
+ * \brief Get the SPI clock of a device.
+ *
+ * \param chip_sel Chip select of the device.
+ *
+ * \return SPI clock (Hz).
+ */
+uint32_t spi_get_clock(uint8_t chip_sel)
+{
+	uint32_t scbr = (SPI0->SPI_CSR[chip_sel] & SPI_CSR_SCBR_Msk) >> SPI_CSR_SCBR_Pos;
+	
+	return scbr ? (sysclk_get_peripheral_hz() / scbr) : 0;
 }
 
 /**
@@ -34,9 +103,12 @@ printf("Setting SPI clock %lu Hz\n\r", (unsigned long)gs_ul_spi_clock);
  */
 void spi_master_initialize(void)
 {	
-	spi_set_clock_configuration(gs_ul_spi_clock);
+	/* transfers run on the XDMAC, the SPI interrupt is not used */
+	NVIC_ClearPendingIRQ(SPI_IRQn);
+	NVIC_DisableIRQ(SPI_IRQn);
 	#ifdef _DEBUG_
 puts("-I- Initialize SPI as master\r");
+printf("Setting SPI clock %lu Hz\n\r", (unsigned long)gs_ul_spi_clock);
 #endif
 	
 	/* Configure an SPI peripheral. */
@@ -46,26 +118,303 @@ puts("-I- Initialize SPI as master\r");
 	spi_set_lastxfer(SPI0);
 	spi_set_master_mode(SPI0);
 	spi_disable_mode_fault_detect(SPI0);
-	spi_set_peripheral_chip_select_value(SPI0, SPI_CHIP_PCS);
-	spi_configure_cs_behavior(SPI0, SPI_CHIP_SEL, SPI_CS_RISE_NO_TX);
+	spi_set_variable_peripheral_select(SPI0);
 	spi_set_delay_between_chip_select(SPI0, SPI_DLYBCS);
-	spi_set_clock_polarity(SPI0, SPI_CHIP_SEL, SPI_CLK_POLARITY);
-	spi_set_clock_phase(SPI0, SPI_CHIP_SEL, SPI_CLK_PHASE);
-	spi_set_bits_per_transfer(SPI0, SPI_CHIP_SEL, SPI_CSR_BITS_8_BIT);
-	spi_set_baudrate_div(SPI0, SPI_CHIP_SEL, (sysclk_get_peripheral_hz() / gs_ul_spi_clock));
-	spi_set_transfer_delay(SPI0, SPI_CHIP_SEL, SPI_DLYBS, SPI_DLYBCT);
+	spi_master_setup_cs(SPI_CHIP_SEL);
 	spi_enable(SPI0);
+	
+	/* RX and TX channel of the transfers, only the RX channel interrupts */
+	pmc_enable_periph_clk(ID_XDMAC);
+	XDMAC->XDMAC_GD = (1 << SPI_XDMAC_TX_CH) | (1 << SPI_XDMAC_RX_CH);
+	XDMAC->XDMAC_GIE = (1 << SPI_XDMAC_RX_CH);
+	NVIC_ClearPendingIRQ(XDMAC_IRQn);
+	NVIC_SetPriority(XDMAC_IRQn, SPI_XDMAC_PRIORITY);
+	NVIC_EnableIRQ(XDMAC_IRQn);
 }
 
 /**
- * \brief Perform SPI master transfer.
+ * \brief Configure a chip select of SPI0 and its NPCS pin.
+ * Every device on SPI0 uses the same mode and clock, the chip select is picked per transfer.
  *
- * \param p_buf Pointer to buffer to transfer.
+ * \param chip_sel Chip select (NPCS0..NPCS3) of the device.
+ */
+void spi_master_setup_cs(uint8_t chip_sel)
+{
+	if (chip_sel >= sizeof(npcs_pin) / sizeof(npcs_pin[0]))
+	{
+		return;
+	}
+	ioport_set_pin_mode(npcs_pin[chip_sel], npcs_flags[chip_sel]);
+	ioport_disable_pin(npcs_pin[chip_sel]);
+	
+	spi_configure_cs_behavior(SPI0, chip_sel, SPI_CS_KEEP_LOW);
+	spi_set_clock_polarity(SPI0, chip_sel, SPI_CLK_POLARITY);
+	spi_set_clock_phase(SPI0, chip_sel, SPI_CLK_PHASE);
+	spi_set_bits_per_transfer(SPI0, chip_sel, SPI_CSR_BITS_8_BIT);
+	spi_set_baudrate_div(SPI0, chip_sel, (sysclk_get_peripheral_hz() / gs_ul_spi_clock));
+	spi_set_transfer_delay(SPI0, chip_sel, SPI_DLYBS, SPI_DLYBCT);
+}
+
+/**
+ * \brief Check if the data cache is enabled (CONF_BOARD_ENABLE_CACHE).
+ */
+static inline bool spi_dcache_enabled(void)
+{
+	return (SCB->CCR & SCB_CCR_DC_Msk) != 0;
+}
+
+/**
+ * \brief Invalidate the buffers of the transfers in the air, the CPU then sees the received bytes.
+ */
+static void spi_dcache_invalidate_rx(void)
+{
+	uint8_t cmd;
+	
+	if (!spi_dcache_enabled())
+	{
+		return;
+	}
+	for (cmd = 0; cmd < spi_xfer_list.count; cmd++)
+	{
+		SCB_InvalidateDCache_by_Addr((uint32_t *)spi_xfer_list.p_buf[cmd], spi_xfer_list.size[cmd]);
+	}
+}
+
+/**
+ * \brief Start the transfers of a command list on the XDMAC channels.
+ * The TX channel sends all transfers as one microblock, the RX channel writes the received bytes
+ * over the buffers of the list and finishes after the TX channel. A list of one transfer needs
+ * no descriptors.
+ *
+ * \param irq Interrupt on completion of the RX channel.
+ */
+static void spi_xdmac_start(uint8_t chip_sel, const spi_list_t *p_list, bool irq)
+{
+	XdmacChid *p_tx = &XDMAC->XDMAC_CHID[SPI_XDMAC_TX_CH];
+	XdmacChid *p_rx = &XDMAC->XDMAC_CHID[SPI_XDMAC_RX_CH];
+	uint32_t pcs = SPI_TDR_PCS(spi_get_pcs(chip_sel));
+	uint32_t words = 0;
+	uint8_t cmd;
+	uint8_t i;
+	
+	for (cmd = 0; cmd < p_list->count; cmd++)
+	{
+		for (i = 0; i < p_list->size[cmd]; i++)
+		{
+			spi_tx_word[words++] = SPI_TDR_TD(p_list->p_buf[cmd][i]) | pcs;
+		}
+		spi_tx_word[words - 1] |= SPI_TDR_LASTXFER; //chip select cycle per transfer
+		
+		spi_rx_desc[cmd].mbr_nda = (uint32_t)&spi_rx_desc[cmd + 1];
+		spi_rx_desc[cmd].mbr_ubc = XDMAC_UBC_NVIEW_NDV1 | XDMAC_UBC_NDEN | XDMAC_CUBC_UBLEN(p_list->size[cmd]) |
+			(((cmd + 1) < p_list->count) ? XDMAC_UBC_NDE : 0);
+		spi_rx_desc[cmd].mbr_ta = (uint32_t)p_list->p_buf[cmd];
+	}
+	
+	/* the XDMAC does not see the data cache: write the TX words and descriptors to memory
+	   and drop cached lines of the RX buffers, they could be evicted over the received bytes */
+	spi_xfer_list = *p_list;
+	if (spi_dcache_enabled())
+	{
+		SCB_CleanDCache_by_Addr((uint32_t *)spi_tx_word, words * sizeof(uint32_t));
+		SCB_CleanDCache_by_Addr((uint32_t *)spi_rx_desc, sizeof(spi_rx_desc));
+		for (cmd = 0; cmd < p_list->count; cmd++)
+		{
+			SCB_CleanInvalidateDCache_by_Addr((uint32_t *)p_list->p_buf[cmd], p_list->size[cmd]);
+		}
+	}
+	
+	/* drop a stale byte, the RX channel must only see this transfer */
+	if (SPI0->SPI_SR & SPI_SR_RDRF)
+	{
+		(void)SPI0->SPI_RDR;
+	}
+	(void)p_tx->XDMAC_CIS;
+	(void)p_rx->XDMAC_CIS;
+	
+	p_rx->XDMAC_CSA = (uint32_t)&SPI0->SPI_RDR;
+	p_rx->XDMAC_CC = XDMAC_CC_TYPE_PER_TRAN | XDMAC_CC_MBSIZE_SINGLE | XDMAC_CC_DSYNC_PER2MEM |
+		XDMAC_CC_CSIZE_CHK_1 | XDMAC_CC_DWIDTH_BYTE | XDMAC_CC_SIF_AHB_IF1 | XDMAC_CC_DIF_AHB_IF0 |
+		XDMAC_CC_SAM_FIXED_AM | XDMAC_CC_DAM_INCREMENTED_AM | XDMAC_CC_PERID(SPI_XDMAC_RX_PERID);
+	if (p_list->count == 1)
+	{
+		p_rx->XDMAC_CDA = (uint32_t)p_list->p_buf[0];
+		p_rx->XDMAC_CUBC = XDMAC_CUBC_UBLEN(p_list->size[0]);
+		p_rx->XDMAC_CNDC = 0;
+	}
+	else
+	{
+		p_rx->XDMAC_CNDA = (uint32_t)&spi_rx_desc[0];
+		p_rx->XDMAC_CNDC = XDMAC_CNDC_NDE_DSCR_FETCH_EN | XDMAC_CNDC_NDDUP_DST_PARAMS_UPDATED | XDMAC_CNDC_NDVIEW_NDV1;
+		p_rx->XDMAC_CUBC = 0;
+	}
+	p_rx->XDMAC_CBC = 0;
+	p_rx->XDMAC_CDS_MSP = 0;
+	p_rx->XDMAC_CSUS = 0;
+	p_rx->XDMAC_CDUS = 0;
+	
+	p_tx->XDMAC_CSA = (uint32_t)spi_tx_word;
+	p_tx->XDMAC_CDA = (uint32_t)&SPI0->SPI_TDR;
+	p_tx->XDMAC_CUBC = XDMAC_CUBC_UBLEN(words);
+	p_tx->XDMAC_CC = XDMAC_CC_TYPE_PER_TRAN | XDMAC_CC_MBSIZE_SINGLE | XDMAC_CC_DSYNC_MEM2PER |
+		XDMAC_CC_CSIZE_CHK_1 | XDMAC_CC_DWIDTH_WORD | XDMAC_CC_SIF_AHB_IF0 | XDMAC_CC_DIF_AHB_IF1 |
+		XDMAC_CC_SAM_INCREMENTED_AM | XDMAC_CC_DAM_FIXED_AM | XDMAC_CC_PERID(SPI_XDMAC_TX_PERID);
+	p_tx->XDMAC_CNDC = 0;
+	p_tx->XDMAC_CBC = 0;
+	p_tx->XDMAC_CDS_MSP = 0;
+	p_tx->XDMAC_CSUS = 0;
+	p_tx->XDMAC_CDUS = 0;
+	
+	if (irq)
+	{
+		p_rx->XDMAC_CIE = (p_list->count == 1) ? XDMAC_CIE_BIE : XDMAC_CIE_LIE;
+	}
+	else
+	{
+		p_rx->XDMAC_CID = XDMAC_CID_BID | XDMAC_CID_LID;
+	}
+	__DSB();
+	XDMAC->XDMAC_GE = (1 << SPI_XDMAC_RX_CH) | (1 << SPI_XDMAC_TX_CH);
+}
+
+/**
+ * \brief Finish the asynchronous transfer and call its callback.
+ */
+static void spi_xdmac_done(void)
+{
+	spi_xfer_cb_t callback = spi_xfer_callback;
+	
+	spi_dcache_invalidate_rx();
+	spi_xfer_pending = false;
+	if (callback)
+	{
+		callback(spi_xfer_arg);
+	}
+}
+
+/**
+ * \brief XDMAC interrupt handler, the RX channel finished an asynchronous transfer.
+ */
+void XDMAC_Handler(void)
+{
+	uint32_t status = XDMAC->XDMAC_CHID[SPI_XDMAC_RX_CH].XDMAC_CIS;
+	
+	if ((status & (XDMAC_CIS_BIS | XDMAC_CIS_LIS)) && spi_xfer_pending)
+	{
+		spi_xdmac_done();
+	}
+}
+
+/**
+ * \brief Start an SPI master transfer to one device in the background.
+ * The bytes are clocked out by the XDMAC, the CPU is free until the callback.
+ *
+ * \param chip_sel Chip select of the device, configured by spi_master_setup_cs().
+ * \param p_buf Pointer to buffer to transfer, must stay valid until the callback.
+ * \param size Size of the buffer, 1 to SPI_XFER_MAX.
+ * \param callback Called from the XDMAC interrupt when p_buf holds the received SPI data, can be NULL.
+ * \param arg Passed to callback.
+ *
+ * \return false when another transfer is running or size is out of range.
+ */
+bool spi_master_transfer_async(uint8_t chip_sel, void *p_buf, uint32_t size, spi_xfer_cb_t callback, void *arg)
+{
+	spi_list_t list;
+	
+	spi_list_init(&list);
+	if ((size > SPI_XFER_MAX) || !spi_list_add(&list, p_buf, size))
+	{
+		return false;
+	}
+	return spi_master_transfer_list(chip_sel, &list, callback, arg);
+}
+
+/**
+ * \brief Empty a command list.
+ */
+void spi_list_init(spi_list_t *p_list)
+{
+	p_list->count = 0;
+	p_list->total = 0;
+}
+
+/**
+ * \brief Append a transfer to a command list.
+ *
+ * \param p_buf Pointer to buffer to transfer, must stay valid until the list finished.
+ *              Aligned to SPI_DCACHE_LINE and padded to whole lines when the data cache is used.
  * \param size Size of the buffer.
- * 
- * \brief after function p_buf will contain the received SPI data  
+ *
+ * \return false when the list is full.
  */
-void spi_master_transfer(void *p_buf, uint32_t size)
+bool spi_list_add(spi_list_t *p_list, void *p_buf, uint8_t size)
+{
+	if ((size == 0) || (p_list->count == SPI_LIST_CMDS) || ((p_list->total + size) > SPI_LIST_MAX))
+	{
+		return false;
+	}
+	p_list->p_buf[p_list->count] = p_buf;
+	p_list->size[p_list->count] = size;
+	p_list->count++;
+	p_list->total += size;
+	return true;
+}
+
+/**
+ * \brief Start the transfers of a command list to one device in the background.
+ * The transfers run back to back without CPU, the callback follows the last transfer.
+ *
+ * \param chip_sel Chip select of the device, configured by spi_master_setup_cs().
+ * \param p_list Transfers to perform, the list itself can be reused after the call.
+ * \param callback Called from the XDMAC interrupt when the buffers hold the received SPI data, can be NULL.
+ * \param arg Passed to callback.
+ *
+ * \return false when another transfer is running or the list is empty.
+ */
+bool spi_master_transfer_list(uint8_t chip_sel, const spi_list_t *p_list, spi_xfer_cb_t callback, void *arg)
+{
+	if ((p_list->count == 0) || spi_master_busy() || spi_xfer_pending)
+	{
+		return false;
+	}
+	spi_xfer_callback = callback;
+	spi_xfer_arg = arg;
+	spi_xfer_pending = true;
+	spi_xdmac_start(chip_sel, p_list, true);
+	return true;
+}
+
+/**
+ * \brief Check if a transfer is running on the XDMAC channels.
+ */
+bool spi_master_busy(void)
+{
+	return (XDMAC->XDMAC_GS & (1 << SPI_XDMAC_RX_CH)) != 0;
+}
+
+/**
+ * \brief Wait until the asynchronous transfer finished and its callback ran.
+ * Can be called from interrupts above the XDMAC interrupt, the callback then runs here.
+ */
+void spi_master_wait(void)
+{
+	while (spi_master_busy());
+	
+	NVIC_DisableIRQ(XDMAC_IRQn);
+	if (spi_xfer_pending)
+	{
+		(void)XDMAC->XDMAC_CHID[SPI_XDMAC_RX_CH].XDMAC_CIS;
+		NVIC_ClearPendingIRQ(XDMAC_IRQn);
+		spi_xdmac_done();
+	}
+	NVIC_EnableIRQ(XDMAC_IRQn);
+}
+
+/**
+ * \brief Perform SPI master transfer to one device, byte by byte.
+ * Used for transfers longer than the DMA buffer.
+ */
+static void spi_master_transfer_polled(uint8_t chip_sel, void *p_buf, uint32_t size)
 {
 	uint32_t i;
 	uint8_t uc_pcs;
@@ -76,18 +425,62 @@ void spi_master_transfer(void *p_buf, uint32_t size)
 	p_buffer = p_buf;
 
 	for (i = 0; i < size; i++) {
-		if (i != size)
+		if (i != (size - 1))
 		{
-			spi_write(SPI0, p_buffer[i], 0, 0);
+			spi_write(SPI0, p_buffer[i], spi_get_pcs(chip_sel), 0);
 		}
 		else
 		{
-			spi_write(SPI0, p_buffer[i], 0, 1);
+			spi_write(SPI0, p_buffer[i], spi_get_pcs(chip_sel), 1);
 		}
 		/* Wait transfer done. */
 		while ((spi_read_status(SPI0) & SPI_SR_RDRF) == 0);
 		spi_read(SPI0, &data, &uc_pcs);
 		p_buffer[i] = data;
 	}
-	delay_us(2);
+}
+
+/**
+ * \brief Perform SPI master transfer to one device.
+ * The chip select stays low for the whole buffer and is released after the last byte.
+ * Blocking wrapper of the XDMAC transfer, a running asynchronous transfer is finished first.
+ *
+ * \param chip_sel Chip select of the device, configured by spi_master_setup_cs().
+ * \param p_buf Pointer to buffer to transfer.
+ * \param size Size of the buffer.
+ * 
+ * \brief after function p_buf will contain the received SPI data  
+ */
+void spi_master_transfer_cs(uint8_t chip_sel, void *p_buf, uint32_t size)
+{
+	if (size == 0)
+	{
+		return;
+	}
+	spi_master_wait();
+	if (size > SPI_XFER_MAX)
+	{
+		spi_master_transfer_polled(chip_sel, p_buf, size);
+	}
+	else
+	{
+		spi_list_t list;
+		
+		spi_list_init(&list);
+		spi_list_add(&list, p_buf, size);
+		spi_xdmac_start(chip_sel, &list, false);
+		while (spi_master_busy());
+		spi_dcache_invalidate_rx();
+	}
+}
+
+/**
+ * \brief Perform SPI master transfer to the default device (SPI_CHIP_SEL).
+ *
+ * \param p_buf Pointer to buffer to transfer.
+ * \param size Size of the buffer.
+ */
+void spi_master_transfer(void *p_buf, uint32_t size)
+{
+	spi_master_transfer_cs(SPI_CHIP_SEL, p_buf, size);
 }
\ No newline at end of file
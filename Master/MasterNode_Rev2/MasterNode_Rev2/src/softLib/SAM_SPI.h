@@ -14,7 +14,7 @@
 #define SPI_Handler     SPI0_Handler
 #define SPI_IRQn        SPI0_IRQn
 
-/* chip select */
+/* chip select, the default device of spi_master_transfer (EXT1 SS) */
 #define SPI_CHIP_SEL 1
 #define SPI_CHIP_PCS spi_get_pcs(SPI_CHIP_SEL)
 
@@ -24,8 +24,8 @@
 /*Clock phase*/
 #define SPI_CLK_PHASE 1
 
-/* Delay between chip selects*/
-#define SPI_DLYBCS 0x05
+/* Delay between chip selects, also the CSN high time between two commands (nRF24 tCWH >= 50ns) */
+#define SPI_DLYBCS 0x08
 
 /* Delay before SPCK. */
 #define SPI_DLYBS 0x20
@@ -33,15 +33,59 @@
 /* Delay between consecutive transfers. */
 #define SPI_DLYBCT 0x08
 
-/* Number of SPI clock configurations. */
-#define NUM_SPCK_CONFIGURATIONS 1
+/* Number of SPI clock configurations, see spi_set_clock_configuration(). */
+#define NUM_SPCK_CONFIGURATIONS 4
+
+/* Number of chip select delay configurations, see spi_set_delay_configuration(). */
+#define NUM_DELAY_CONFIGURATIONS 3
 
 /** spi mode definition*/
 #define	MASTER_MODE   0
 
+/* XDMAC channels and hardware interfaces (XDMAC_CC.PERID) of SPI0 */
+#define SPI_XDMAC_TX_CH     0
+#define SPI_XDMAC_RX_CH     1
+#define SPI_XDMAC_TX_PERID  1
+#define SPI_XDMAC_RX_PERID  2
+#define SPI_XDMAC_PRIORITY  3
+
+/* Cortex-M7 data cache line. With CONF_BOARD_ENABLE_CACHE the buffers of the transfers must be aligned
+   to it and padded to whole lines, they are cleaned and invalidated around every transfer. */
+#define SPI_DCACHE_LINE     32
+
+/* Largest DMA transfer in bytes: a nRF24 command with a 32 byte payload */
+#define SPI_XFER_MAX        33
+
+/* Called when an asynchronous transfer finished, from the XDMAC interrupt */
+typedef void (*spi_xfer_cb_t)(void *arg);
+
+/* Command list: up to SPI_LIST_CMDS transfers to one device executed back to back by the XDMAC.
+   Every transfer gets its own chip select cycle (LASTXFER), the received bytes are scattered back
+   into the buffers by a linked list of RX descriptors and the list ends with a single interrupt. */
+#define SPI_LIST_CMDS       6
+#define SPI_LIST_MAX        64 //bytes of all transfers in a list
+
+typedef struct {
+	uint8_t *p_buf[SPI_LIST_CMDS];
+	uint8_t size[SPI_LIST_CMDS];
+	uint8_t count;
+	uint8_t total;
+} spi_list_t;
+
 extern uint32_t gs_ul_spi_clock;
 
 void spi_master_initialize(void);
+void spi_master_setup_cs(uint8_t chip_sel);
+uint32_t spi_set_clock_configuration(uint8_t chip_sel, uint8_t configuration);
+void spi_set_delay_configuration(uint8_t chip_sel, uint8_t configuration);
+uint32_t spi_get_clock(uint8_t chip_sel);
+void spi_master_transfer_cs(uint8_t chip_sel, void *p_buf, uint32_t size);
 void spi_master_transfer(void *p_buf, uint32_t size);
+bool spi_master_transfer_async(uint8_t chip_sel, void *p_buf, uint32_t size, spi_xfer_cb_t callback, void *arg);
+void spi_list_init(spi_list_t *p_list);
+bool spi_list_add(spi_list_t *p_list, void *p_buf, uint8_t size);
+bool spi_master_transfer_list(uint8_t chip_sel, const spi_list_t *p_list, spi_xfer_cb_t callback, void *arg);
+bool spi_master_busy(void);
+void spi_master_wait(void);
 
 #endif /* SAM_SPI_H_ */
\ No newline at end of file
@@ -0,0 +1,85 @@
+/*
+ * SAM_TC.c
+ *
+ * Created: 17/10/2026 14:01:37
+ *  Author: Design
+ */ 
+
+#include "SAM_TC.h"
+
+/* Set by the timer interrupt, cleared by the main loop */
+static volatile bool gs_b_radio_tick = false;
+
+/**
+ * \brief Start a Timer/Counter channel that fires the radio output tick.
+ *
+ * \param ul_rate_hz Number of ticks per second.
+ */
+void tc_radio_initialize(uint32_t ul_rate_hz)
+{
+	TcChannel *p_ch = &RADIO_TC->TC_CHANNEL[RADIO_TC_CHANNEL];
+	
+	pmc_enable_periph_clk(RADIO_TC_ID);
+	
+	/* Waveform mode, counter restarts on RC compare */
+	p_ch->TC_CCR = TC_CCR_CLKDIS;
+	p_ch->TC_IDR = 0xFFFFFFFF;
+	p_ch->TC_CMR = RADIO_TC_CLOCK | TC_CMR_WAVE | TC_CMR_WAVSEL_UP_RC;
+	p_ch->TC_RC = (sysclk_get_peripheral_hz() / RADIO_TC_DIVIDER) / ul_rate_hz;
+	p_ch->TC_IER = TC_IER_CPCS;
+	
+	NVIC_ClearPendingIRQ(RADIO_TC_IRQn);
+	NVIC_SetPriority(RADIO_TC_IRQn, 1);
+	NVIC_EnableIRQ(RADIO_TC_IRQn);
+	
+	p_ch->TC_CCR = TC_CCR_CLKEN | TC_CCR_SWTRG;
+}
+
+/**
+ * \brief Consume a pending radio output tick.
+ *
+ * \return true once for every elapsed tick period, ticks that were missed are merged.
+ */
+bool tc_radio_tick(void)
+{
+	if (!gs_b_radio_tick) {
+		return false;
+	}
+	gs_b_radio_tick = false;
+	return true;
+}
+
+/**
+ * \brief Check for a pending radio output tick without consuming it.
+ */
+bool tc_radio_tick_pending(void)
+{
+	return gs_b_radio_tick;
+}
+
+/**
+ * \brief Start the free running Timer/Counter channel of the latency trace timestamps.
+ * The 16 bit counter wraps after 65536 / LATENCY_TC_HZ seconds, no interrupt.
+ */
+void tc_latency_initialize(void)
+{
+	TcChannel *p_ch = &LATENCY_TC->TC_CHANNEL[LATENCY_TC_CHANNEL];
+	
+	pmc_enable_periph_clk(LATENCY_TC_ID);
+	
+	/* Waveform mode, counter runs up to 0xFFFF and wraps */
+	p_ch->TC_CCR = TC_CCR_CLKDIS;
+	p_ch->TC_IDR = 0xFFFFFFFF;
+	p_ch->TC_CMR = LATENCY_TC_CLOCK | TC_CMR_WAVE | TC_CMR_WAVSEL_UP;
+	p_ch->TC_CCR = TC_CCR_CLKEN | TC_CCR_SWTRG;
+}
+
+/**
+ * \brief Timer/Counter interrupt handler.
+ */
+void RADIO_TC_Handler(void)
+{
+	if (RADIO_TC->TC_CHANNEL[RADIO_TC_CHANNEL].TC_SR & TC_SR_CPCS) {
+		gs_b_radio_tick = true;
+	}
+}
@@ -0,0 +1,38 @@
+/*
+ * SAM_TC.h
+ *
+ * Created: 17/10/2026 14:02:11
+ *  Author: Design
+ */ 
+
+
+#ifndef SAM_TC_H_
+#define SAM_TC_H_
+
+#include <asf.h>
+
+/* Timer/Counter channel used for the radio output tick */
+#define RADIO_TC            TC0
+#define RADIO_TC_CHANNEL    0
+#define RADIO_TC_ID         ID_TC0
+#define RADIO_TC_IRQn       TC0_IRQn
+#define RADIO_TC_Handler    TC0_Handler
+
+/* Timer clock: MCK/128 */
+#define RADIO_TC_CLOCK      TC_CMR_TCCLKS_TIMER_CLOCK4
+#define RADIO_TC_DIVIDER    128
+
+/* Timer/Counter channel used for the latency trace timestamps, free running on the slow clock (SLCK)
+   so it keeps counting while the core sleeps (WFI) */
+#define LATENCY_TC          TC0
+#define LATENCY_TC_CHANNEL  1
+#define LATENCY_TC_ID       ID_TC1
+#define LATENCY_TC_CLOCK    TC_CMR_TCCLKS_TIMER_CLOCK5
+#define LATENCY_TC_HZ       32768
+
+void tc_radio_initialize(uint32_t ul_rate_hz);
+bool tc_radio_tick(void);
+bool tc_radio_tick_pending(void);
+void tc_latency_initialize(void);
+
+#endif /* SAM_TC_H_ */
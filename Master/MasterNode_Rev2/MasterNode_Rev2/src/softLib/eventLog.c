@@ -0,0 +1,131 @@
+/*
+ * eventLog.c
+ *
+ * Created: 17/10/2026 18:47:31
+ *  Author: Design
+ */
+
+#include <string.h>
+#include "eventLog.h"
+
+/* Ring of records. gs_ul_head and gs_ul_tail run free, the slot is the index modulo EVENTLOG_RECORDS.
+   Writers (main loop and interrupts) reserve a slot with a compare-and-swap on gs_ul_head and set sync last,
+   the drain only takes slots with sync set and clears it before it frees the slot by moving gs_ul_tail. */
+static eventlog_record_t gs_ring[EVENTLOG_RECORDS];
+static volatile uint32_t gs_ul_head;
+static volatile uint32_t gs_ul_tail;
+static volatile uint32_t gs_ul_dropped;
+
+/* Records in the air, the XDMAC reads them from memory */
+COMPILER_ALIGNED(32) static eventlog_record_t gs_dma_records[EVENTLOG_DMA_RECORDS];
+
+/**
+ * \brief Start the DWT cycle counter of the timestamps and prepare the XDMAC channel of the console USART.
+ * The console must be configured.
+ */
+void eventlog_initialize(void)
+{
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->LAR = 0xC5ACCE55; //unlock the DWT on the Cortex-M7
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+	pmc_enable_periph_clk(ID_XDMAC);
+	XDMAC->XDMAC_GD = (1 << EVENTLOG_XDMAC_CH);
+	XDMAC->XDMAC_CHID[EVENTLOG_XDMAC_CH].XDMAC_CID = 0xFFFFFFFF;
+	gs_ul_head = 0;
+	gs_ul_tail = 0;
+	gs_ul_dropped = 0;
+}
+
+/**
+ * \brief Log an event, never blocks.
+ *
+ * \param id Event id (enum eventlog_id).
+ * \param ul_args Argument bytes 0-3, see EVENTLOG_BYTES() and EVENTLOG_HALVES().
+ * \param us_args_hi Argument bytes 4-5.
+ */
+void eventlog_write(uint8_t id, uint32_t ul_args, uint16_t us_args_hi)
+{
+	eventlog_record_t *p_rec;
+	uint32_t head = __atomic_load_n(&gs_ul_head, __ATOMIC_RELAXED);
+
+	do {
+		if ((head - __atomic_load_n(&gs_ul_tail, __ATOMIC_ACQUIRE)) >= EVENTLOG_RECORDS) {
+			__atomic_fetch_add(&gs_ul_dropped, 1, __ATOMIC_RELAXED);
+			return;
+		}
+	} while (!__atomic_compare_exchange_n(&gs_ul_head, &head, head + 1, true, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+
+	p_rec = &gs_ring[head & (EVENTLOG_RECORDS - 1)];
+	p_rec->id = id;
+	p_rec->arg[0] = (uint8_t)ul_args;
+	p_rec->arg[1] = (uint8_t)(ul_args >> 8);
+	p_rec->arg[2] = (uint8_t)(ul_args >> 16);
+	p_rec->arg[3] = (uint8_t)(ul_args >> 24);
+	p_rec->arg[4] = (uint8_t)us_args_hi;
+	p_rec->arg[5] = (uint8_t)(us_args_hi >> 8);
+	p_rec->stamp = DWT->CYCCNT;
+	__atomic_store_n(&p_rec->sync, EVENTLOG_SYNC, __ATOMIC_RELEASE);
+}
+
+/**
+ * \brief Send the logged records out of the console USART.
+ * Returns right away while the previous transfer is running, call it from the main loop.
+ * A count of dropped records follows as an EV_LOG_DROPPED record.
+ */
+void eventlog_drain(void)
+{
+	XdmacChid *p_ch = &XDMAC->XDMAC_CHID[EVENTLOG_XDMAC_CH];
+	eventlog_record_t *p_rec;
+	uint32_t tail = gs_ul_tail;
+	uint32_t dropped;
+	uint8_t count = 0;
+
+	if (XDMAC->XDMAC_GS & (1 << EVENTLOG_XDMAC_CH)) {
+		return;
+	}
+
+	while ((count < EVENTLOG_DMA_RECORDS) && (tail != __atomic_load_n(&gs_ul_head, __ATOMIC_ACQUIRE))) {
+		p_rec = &gs_ring[tail & (EVENTLOG_RECORDS - 1)];
+		if (__atomic_load_n(&p_rec->sync, __ATOMIC_ACQUIRE) != EVENTLOG_SYNC) {
+			//reserved by a writer that was interrupted, taken on the next drain
+			break;
+		}
+		gs_dma_records[count++] = *p_rec;
+		p_rec->sync = 0;
+		tail++;
+		__atomic_store_n(&gs_ul_tail, tail, __ATOMIC_RELEASE);
+	}
+	if ((count < EVENTLOG_DMA_RECORDS) && gs_ul_dropped) {
+		dropped = __atomic_exchange_n(&gs_ul_dropped, 0, __ATOMIC_RELAXED);
+		p_rec = &gs_dma_records[count++];
+		p_rec->sync = EVENTLOG_SYNC;
+		p_rec->id = EV_LOG_DROPPED;
+		memset(p_rec->arg, 0, sizeof(p_rec->arg));
+		memcpy(p_rec->arg, &dropped, sizeof(dropped));
+		p_rec->stamp = DWT->CYCCNT;
+	}
+	if (count == 0) {
+		return;
+	}
+
+	//the XDMAC reads the records from memory, push them out of the data cache
+	if (SCB->CCR & SCB_CCR_DC_Msk) {
+		SCB_CleanDCache_by_Addr((uint32_t *)gs_dma_records, sizeof(gs_dma_records));
+	}
+
+	(void)p_ch->XDMAC_CIS;
+	p_ch->XDMAC_CSA = (uint32_t)gs_dma_records;
+	p_ch->XDMAC_CDA = (uint32_t)&CONSOLE_UART->US_THR;
+	p_ch->XDMAC_CUBC = XDMAC_CUBC_UBLEN(count * sizeof(eventlog_record_t));
+	p_ch->XDMAC_CC = XDMAC_CC_TYPE_PER_TRAN | XDMAC_CC_MBSIZE_SINGLE | XDMAC_CC_DSYNC_MEM2PER |
+		XDMAC_CC_CSIZE_CHK_1 | XDMAC_CC_DWIDTH_BYTE | XDMAC_CC_SIF_AHB_IF0 | XDMAC_CC_DIF_AHB_IF1 |
+		XDMAC_CC_SAM_INCREMENTED_AM | XDMAC_CC_DAM_FIXED_AM | XDMAC_CC_PERID(EVENTLOG_XDMAC_PERID);
+	p_ch->XDMAC_CNDC = 0;
+	p_ch->XDMAC_CBC = 0;
+	p_ch->XDMAC_CDS_MSP = 0;
+	p_ch->XDMAC_CSUS = 0;
+	p_ch->XDMAC_CDUS = 0;
+	__DSB();
+	XDMAC->XDMAC_GE = (1 << EVENTLOG_XDMAC_CH);
+}
@@ -0,0 +1,76 @@
+/*
+ * eventLog.h
+ *
+ * Created: 17/10/2026 18:47:05
+ *  Author: Design
+ */
+
+
+#ifndef EVENTLOG_H_
+#define EVENTLOG_H_
+
+#include <asf.h>
+
+/* Deferred event log.
+   The hot path stores fixed size binary records (event id, 6 bytes of arguments, DWT cycle counter) in a
+   lock-free ring without formatting anything, a full ring drops the record and counts it.
+   eventlog_drain() runs from the main loop and clocks the records out of the console USART with the XDMAC,
+   ../tools/eventlog_decode.py (next to the solution) formats them on the host with the table below. */
+#define EVENTLOG_RECORDS        256 //power of two
+#define EVENTLOG_DMA_RECORDS    16 //records per USART transfer
+#define EVENTLOG_SYNC           0xA5 //first byte of every record on the wire
+
+/* XDMAC channel of the console USART (USART1 TX), the SPI uses channel 0 and 1 */
+#define EVENTLOG_XDMAC_CH       2
+#define EVENTLOG_XDMAC_PERID    9
+
+/* Event table: id, argument layout (Python struct, little endian) and host format string.
+   Keep the order, the id is the position in the table. */
+#define EVENTLOG_EVENTS(X) \
+	X(EV_LOG_DROPPED,        "I",     "log: %u records dropped") \
+	X(EV_UDP,                "H",     "M: UDP %u bytes") \
+	X(EV_DMX,                "HH",    "M: DMX port 0x%04x, %u channels") \
+	X(EV_ARTSYNC,            "",      "M: ArtSync") \
+	X(EV_ARTSYNC_TIMEOUT,    "",      "M: ArtSync timeout") \
+	X(EV_ARTPOLL,            "",      "M: ArtPoll") \
+	X(EV_ARTPOLLREPLY,       "",      "M: ArtPollReply send") \
+	X(EV_ARTPOLLREPLY_ERR,   "B",     "E: ArtPollReply not send - 0x%x") \
+	X(EV_ADDRESS,            "",      "M: Address unicast") \
+	X(EV_ETH_FORMAT,         "H",     "=== Default w_pkt_format= 0x%X===") \
+	X(EV_NODE,               "BBBBB", "Node %d | CMD %d | HSV %d, %d, %d") \
+	X(EV_BROADCAST,          "BB",    "Broadcast nodes %d-%d") \
+	X(EV_TX_FAILED,          "H",     "transmission failed %04x") \
+	X(EV_SENSOR,             "Bb",    "Node %d | sensor %d") \
+	X(EV_LATENCY_RESET,      "",      "M: Latency reset") \
+	X(EV_PROFILE_RESET,      "",      "M: Profile reset") \
+	X(EV_DIAG_REPORT,        "B",     "M: Diag report %u send") \
+	X(EV_DIAG_REPORT_ERR,    "BB",    "E: Diag report %u not send - 0x%x") \
+	X(EV_ARP_REQUEST,        "BBBBBB", "M: ARP request from %02x:%02x:%02x:%02x:%02x:%02x") \
+	X(EV_ARP_SEND_ERR,       "B",     "E: ARP Send - 0x%x") \
+	X(EV_ICMP_SEND_ERR,      "B",     "E: ICMP Send - 0x%x")
+
+#define EVENTLOG_ENUM(id, args, text)	id,
+enum eventlog_id {
+	EV_NONE = 0,
+	EVENTLOG_EVENTS(EVENTLOG_ENUM)
+	EV_COUNT
+};
+
+/* Record on the wire, 12 bytes */
+typedef struct eventlog_record {
+	uint8_t sync; //EVENTLOG_SYNC once the record is complete
+	uint8_t id;
+	uint8_t arg[6];
+	uint32_t stamp; //DWT cycle counter
+} eventlog_record_t;
+
+/* Argument packing for eventlog_write(), little endian like the record */
+#define EVENTLOG_BYTES(b0, b1, b2, b3)	((uint32_t)(uint8_t)(b0) | ((uint32_t)(uint8_t)(b1) << 8) | \
+										((uint32_t)(uint8_t)(b2) << 16) | ((uint32_t)(uint8_t)(b3) << 24))
+#define EVENTLOG_HALVES(h0, h1)			((uint32_t)(uint16_t)(h0) | ((uint32_t)(uint16_t)(h1) << 16))
+
+void eventlog_initialize(void);
+void eventlog_write(uint8_t id, uint32_t ul_args, uint16_t us_args_hi);
+void eventlog_drain(void);
+
+#endif /* EVENTLOG_H_ */
@@ -0,0 +1,142 @@
+/*
+ * latency.c
+ *
+ * Created: 17/10/2026 16:12:58
+ *  Author: Design
+ */
+
+#include <stdio.h>
+#include "latency.h"
+
+/* Written from the radio interrupts, read by the main loop */
+static latency_hist_t gs_latency[LATENCY_NODES];
+
+/**
+ * \brief Start the timer used for the trace timestamps and clear the histograms.
+ */
+void latency_initialize(void)
+{
+	tc_latency_initialize();
+	latency_reset();
+}
+
+/**
+ * \brief Time elapsed since a trace timestamp.
+ *
+ * \param stamp Timestamp taken by latency_stamp() less than 2s ago.
+ *
+ * \return Elapsed time in us.
+ */
+uint32_t latency_since_us(uint16_t stamp)
+{
+	uint16_t ticks = latency_stamp() - stamp;
+
+	return ((uint32_t)ticks * 1000000UL) / LATENCY_TC_HZ;
+}
+
+/**
+ * \brief Add a latency sample to the histogram of a node.
+ *
+ * \param node Node (0 based).
+ * \param ul_us Latency in us.
+ */
+void latency_record(uint8_t node, uint32_t ul_us)
+{
+	latency_hist_t *p_hist;
+	uint32_t bin = ul_us / LATENCY_BIN_US;
+
+	if (node >= LATENCY_NODES) {
+		return;
+	}
+	p_hist = &gs_latency[node];
+	if (bin >= LATENCY_BINS) {
+		bin = LATENCY_BINS - 1;
+	}
+	p_hist->bin[bin]++;
+	if (ul_us < p_hist->min_us) {
+		p_hist->min_us = ul_us;
+	}
+	if (ul_us > p_hist->max_us) {
+		p_hist->max_us = ul_us;
+	}
+	p_hist->count++;
+}
+
+/**
+ * \brief Clear the histograms of all nodes.
+ */
+void latency_reset(void)
+{
+	irqflags_t flags = cpu_irq_save();
+	uint8_t n;
+
+	memset(gs_latency, 0, sizeof(gs_latency));
+	for (n = 0; n < LATENCY_NODES; n++) {
+		gs_latency[n].min_us = UINT32_MAX;
+	}
+	cpu_irq_restore(flags);
+}
+
+/**
+ * \brief Percentile of a histogram.
+ *
+ * \param p_hist Histogram.
+ * \param percent Percentile (1-100).
+ *
+ * \return Upper edge of the bin holding the percentile in us, capped at the largest sample.
+ */
+uint32_t latency_percentile(const latency_hist_t *p_hist, uint8_t percent)
+{
+	uint32_t rank = ((p_hist->count * percent) + 99) / 100;
+	uint32_t seen = 0;
+	uint32_t ul_us;
+	uint32_t bin;
+
+	for (bin = 0; bin < LATENCY_BINS; bin++) {
+		seen += p_hist->bin[bin];
+		if (seen >= rank) {
+			break;
+		}
+	}
+	ul_us = (bin + 1) * LATENCY_BIN_US;
+	return (ul_us < p_hist->max_us) ? ul_us : p_hist->max_us;
+}
+
+/**
+ * \brief Print count, min, p50, p99 and max of every node as text, one line per node.
+ *
+ * \param p_text Output buffer.
+ * \param size Size of p_text.
+ * \param nodes Number of nodes to report.
+ *
+ * \return Length of the text without the terminating zero.
+ */
+uint16_t latency_report(char *p_text, uint16_t size, uint8_t nodes)
+{
+	latency_hist_t hist;
+	uint16_t len = 0;
+	int written;
+	uint8_t n;
+
+	p_text[0] = '\0';
+	for (n = 0; (n < nodes) && (n < LATENCY_NODES); n++) {
+		//snapshot, the radio interrupts keep recording
+		irqflags_t flags = cpu_irq_save();
+		hist = gs_latency[n];
+		cpu_irq_restore(flags);
+
+		if (hist.count == 0) {
+			written = snprintf(&p_text[len], size - len, "Node %d: no samples\n", n + 1);
+		}
+		else {
+			written = snprintf(&p_text[len], size - len, "Node %d: n=%lu min=%lu p50=%lu p99=%lu max=%lu us\n", n + 1,
+				(unsigned long)hist.count, (unsigned long)hist.min_us, (unsigned long)latency_percentile(&hist, 50),
+				(unsigned long)latency_percentile(&hist, 99), (unsigned long)hist.max_us);
+		}
+		if ((written < 0) || (written >= (size - len))) {
+			break;
+		}
+		len += written;
+	}
+	return len;
+}
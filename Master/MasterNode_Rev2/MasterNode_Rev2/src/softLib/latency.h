@@ -0,0 +1,45 @@
+/*
+ * latency.h
+ *
+ * Created: 17/10/2026 16:12:40
+ *  Author: Design
+ */
+
+
+#ifndef LATENCY_H_
+#define LATENCY_H_
+
+#include <asf.h>
+#include "SAM_TC.h"
+
+/* Trace timestamps are the counter of the free running LATENCY_TC channel: one tick per slow clock
+   period (30.5us), a stamp wraps after 2s. Unlike the DWT cycle counter it keeps running while the core sleeps. */
+
+/* Latency histogram per node: LATENCY_BINS bins of LATENCY_BIN_US, slower samples count in the last bin. */
+#define LATENCY_NODES           8
+#define LATENCY_BINS            128
+#define LATENCY_BIN_US          250 //32ms
+
+typedef struct latency_hist {
+	uint32_t count;
+	uint32_t min_us;
+	uint32_t max_us;
+	uint32_t bin[LATENCY_BINS];
+} latency_hist_t;
+
+/**
+ * \brief Current trace timestamp, see LATENCY_TC
+ */
+static inline uint16_t latency_stamp(void)
+{
+	return (uint16_t)LATENCY_TC->TC_CHANNEL[LATENCY_TC_CHANNEL].TC_CV;
+}
+
+void latency_initialize(void);
+uint32_t latency_since_us(uint16_t stamp);
+void latency_record(uint8_t node, uint32_t ul_us);
+void latency_reset(void);
+uint32_t latency_percentile(const latency_hist_t *p_hist, uint8_t percent);
+uint16_t latency_report(char *p_text, uint16_t size, uint8_t nodes);
+
+#endif /* LATENCY_H_ */
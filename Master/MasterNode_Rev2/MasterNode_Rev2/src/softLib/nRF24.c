@@ -9,39 +9,102 @@
 #include "SAM_SPI.h"
 #include "string.h"
 
+#if (NRF24_SPI_BUF % SPI_DCACHE_LINE)
+#error "NRF24_SPI_BUF must be a multiple of the data cache line"
+#endif
 
-/* Globale variabele gebruikt door de nRF24 library */
-uint32_t txDelay; // delay tussen TX paketten
-uint8_t payload_size = 32; // grootte van de payload
-uint8_t addr_width; // adres lengte
-bool dynamic_payloads_enabled = false;
-uint8_t pipe0_reading_address[5]; // dummy locatie voor Pipe0 adres
+
+/* Radios with an IRQ handler (nRF24_txInit), the radios share SPI0 */
+static nrf24_t *irq_device[NRF24_MAX_DEVICES];
+static uint8_t irq_devices;
+
+/* SPI transfer buffers, one for the main context and one for the IRQ interrupt, so no transfer
+   needs stack. The XDMAC reads and writes them: cache line aligned and padded to whole lines. */
+COMPILER_ALIGNED(SPI_DCACHE_LINE) static uint8_t spi_pool[2][NRF24_SPI_BUF];
+
+/* Registers kept in the register shadow of the device.
+   Every write through this driver updates the shadow, so a read of a shadowed register
+   and a write of an unchanged value need no SPI transfer. STATUS, OBSERVE_TX, RPD and
+   FIFO_STATUS change on their own and are always read from the chip. */
+#define SHADOW_REGS ((1UL<<NRF_CONFIG) | (1UL<<EN_AA) | (1UL<<EN_RXADDR) | (1UL<<SETUP_AW) | (1UL<<SETUP_RETR) | \
+                     (1UL<<RF_CH) | (1UL<<RF_SETUP) | (1UL<<RX_PW_P0) | (1UL<<RX_PW_P1) | (1UL<<RX_PW_P2) | \
+                     (1UL<<RX_PW_P3) | (1UL<<RX_PW_P4) | (1UL<<RX_PW_P5) | (1UL<<DYNPD) | (1UL<<FEATURE))
 
 /**
- * \brief read a register of the nRF24L01 transceiver
+ * \brief SPI transfer buffer of the running context (NRF24_SPI_BUF bytes)
+ * The nRF24 IRQ interrupt can preempt the main context but not itself.
+ */
+static uint8_t *spiBuffer(void)
+{
+	return spi_pool[(__get_IPSR() != 0) ? 1 : 0];
+}
+
+/**
+ * \brief read a register of the nRF24L01 transceiver, bypassing the register shadow
  * 
  * \param reg register to read
  * \return data register
  */
-uint8_t nRF24_readRegister(uint8_t reg)
+static uint8_t readRegisterDirect(nrf24_t *dev, uint8_t reg)
 {
-	uint8_t cmd[2] = {R_REGISTER | (REGISTER_MASK & reg), 0xFF};
+	uint8_t *cmd = spiBuffer();
 	
-	spi_master_transfer(&cmd, sizeof(cmd));
+	cmd[0] = R_REGISTER | (REGISTER_MASK & reg);
+	cmd[1] = 0xFF;
+	spi_master_transfer_cs(dev->spi_cs, cmd, 2);
 	
 	/** contents of cmd after transfer:
 	 * [0] contains STATUS register
 	 * [1] contains requested register
 	*/
+	dev->last_status = cmd[0];
+	reg &= REGISTER_MASK;
+	if (SHADOW_REGS & (1UL << reg))
+	{
+		dev->reg_shadow[reg] = cmd[1];
+		dev->reg_shadow_valid |= (1UL << reg);
+	}
 	return cmd[1]; 
 }
 
-static uint8_t read_register(uint8_t reg, uint8_t* buf, uint8_t len)
+/**
+ * \brief read a register of the nRF24L01 transceiver
+ * Shadowed registers are served from the register shadow once they are known.
+ * 
+ * \param reg register to read
+ * \return data register
+ */
+uint8_t nRF24_readRegister(nrf24_t *dev, uint8_t reg)
+{
+	reg &= REGISTER_MASK;
+	if ((SHADOW_REGS & dev->reg_shadow_valid) & (1UL << reg))
+	{
+		return dev->reg_shadow[reg];
+	}
+	return readRegisterDirect(dev, reg);
+}
+
+/**
+ * \brief forget the register shadow, the next reads go to the chip
+ */
+void nRF24_invalidateShadow(nrf24_t *dev)
+{
+	dev->reg_shadow_valid = 0;
+	dev->addr_shadow_valid = 0;
+}
+
+static uint8_t read_register(nrf24_t *dev, uint8_t reg, uint8_t* buf, uint8_t len)
 {
 	//1x spi zenden niet 2 commando's
-	uint8_t status[len+1];
+	uint8_t *status = spiBuffer();
+	
+	if (len > (NRF24_SPI_BUF - 1))
+	{
+		len = NRF24_SPI_BUF - 1;
+	}
 	status[0] = R_REGISTER | (REGISTER_MASK & reg);
-	spi_master_transfer(&status, sizeof(status));
+	memset(&status[1], 0xFF, len);
+	spi_master_transfer_cs(dev->spi_cs, status, len + 1);
 	
 	for (uint8_t i = 0; i< len; i++)
 	{
@@ -54,13 +117,26 @@ static uint8_t read_register(uint8_t reg, uint8_t* buf, uint8_t len)
 /**
  * \brief write to a register of the nRF24L01 transceiver
  * 
+ * A shadowed register that already holds val is not written again.
+ * 
  * \param reg register to write
  * \param value to write
- * \return STATUS register 
+ * \return STATUS register (of the last SPI transfer when the write was skipped)
  */
-uint8_t nRF24_writeRegister(uint8_t reg, uint8_t val)
+uint8_t nRF24_writeRegister(nrf24_t *dev, uint8_t reg, uint8_t val)
 {
-	uint8_t p_buf[2];
+	uint8_t *p_buf = spiBuffer();
+	
+	reg &= REGISTER_MASK;
+	if (((SHADOW_REGS & dev->reg_shadow_valid) & (1UL << reg)) && (dev->reg_shadow[reg] == val))
+	{
+		return dev->last_status;
+	}
+	if (SHADOW_REGS & (1UL << reg))
+	{
+		dev->reg_shadow[reg] = val;
+		dev->reg_shadow_valid |= (1UL << reg);
+	}
 	
 	p_buf[0] = (W_REGISTER | (REGISTER_MASK & reg));
 	p_buf[1] = val;
@@ -69,11 +145,12 @@ uint8_t nRF24_writeRegister(uint8_t reg, uint8_t val)
 	* [1] data to write
 	*/
 	
-	spi_master_transfer(p_buf, sizeof(p_buf));
+	spi_master_transfer_cs(dev->spi_cs, p_buf, 2);
 	/** contents of p_buf after transfer
 	* [0] Status register
 	* [1] unknown data
 	*/
+	dev->last_status = p_buf[0];
 	return p_buf[0]; //return STATUS
 }
 
@@ -85,10 +162,14 @@ uint8_t nRF24_writeRegister(uint8_t reg, uint8_t val)
  * \param length length of data to write
  * \return STATUS register 
  */
-static uint8_t writeRegister(uint8_t reg, const uint8_t* buf, uint8_t length)
+static uint8_t writeRegister(nrf24_t *dev, uint8_t reg, const uint8_t* buf, uint8_t length)
 {
-	uint8_t p_buf[length+1];
+	uint8_t *p_buf = spiBuffer();
 	
+	if (length > (NRF24_SPI_BUF - 1))
+	{
+		length = NRF24_SPI_BUF - 1;
+	}
 	p_buf[0] = (W_REGISTER | (REGISTER_MASK & reg));
 	
 	for (uint8_t i = 0; i < length; i++)
@@ -96,49 +177,69 @@ static uint8_t writeRegister(uint8_t reg, const uint8_t* buf, uint8_t length)
 		p_buf[i+1] = (*buf++);
 		//printf("%d || %02x || %02x\n\r", i, p_buf[i], *buf);
 	}
-	spi_master_transfer(p_buf, sizeof(p_buf));
+	spi_master_transfer_cs(dev->spi_cs, p_buf, length + 1);
 	
+	dev->last_status = p_buf[0];
 	return p_buf[0];
 }
 
+/**
+ * \brief write the pipe 0 RX address or the TX address, skipped when unchanged
+ * 
+ * \param reg RX_ADDR_P0 or TX_ADDR
+ * \param address address to write (addr_width bytes)
+ */
+static void writeAddress(nrf24_t *dev, uint8_t reg, uint64_t address)
+{
+	uint8_t idx = (reg == TX_ADDR) ? 1 : 0;
+	
+	if ((dev->addr_shadow_valid & (1 << idx)) && (dev->addr_shadow[idx] == address))
+	{
+		return;
+	}
+	writeRegister(dev, reg, (const uint8_t *)(&address), dev->addr_width);
+	dev->addr_shadow[idx] = address;
+	dev->addr_shadow_valid |= (1 << idx);
+}
+
 /**
  * \brief flush the RX buffer of the nRF24L01 transceiver
  * \return STATUS
  */
-uint8_t nRF24_FlushRx(void)
+uint8_t nRF24_FlushRx(nrf24_t *dev)
 {
-	uint8_t cmd;
-	cmd = FLUSH_RX;
+	uint8_t *cmd = spiBuffer();
+	cmd[0] = FLUSH_RX;
 	
-	spi_master_transfer(&cmd, sizeof(cmd));
+	spi_master_transfer_cs(dev->spi_cs, cmd, 1);
 	
-	return cmd;
+	return cmd[0];
 }
 
 /**
  * \brief flush the TX buffer of the nRF24L01 transceiver
  * \return STATUS
  */
-uint8_t nRF24_FlushTx(void)
+uint8_t nRF24_FlushTx(nrf24_t *dev)
 {
-	uint8_t cmd;
-	cmd = FLUSH_TX;
+	uint8_t *cmd = spiBuffer();
+	cmd[0] = FLUSH_TX;
 	
-	spi_master_transfer(&cmd, sizeof(cmd));
-	return cmd;
+	spi_master_transfer_cs(dev->spi_cs, cmd, 1);
+	return cmd[0];
 }
 
 /**
  * \brief Read the Status register of the nRF24L01 transceiver
  * \return STATUS
  */
-uint8_t nRF24_getStatus(void)
+uint8_t nRF24_getStatus(nrf24_t *dev)
 {
-	uint8_t cmd;
-	cmd = RF24_NOP;
+	uint8_t *cmd = spiBuffer();
+	cmd[0] = RF24_NOP;
 	
-	spi_master_transfer(&cmd, sizeof(cmd));
-	return cmd;
+	spi_master_transfer_cs(dev->spi_cs, cmd, 1);
+	return cmd[0];
 }
 
 /**
@@ -147,23 +248,23 @@ uint8_t nRF24_getStatus(void)
  * \param speed datarate to be used
  * \return true if set
  */
-bool nRF24_setDataRate(rf24_datarate_e speed)
+bool nRF24_setDataRate(nrf24_t *dev, rf24_datarate_e speed)
 {
 	bool result = false;
-	uint8_t setup = nRF24_readRegister(RF_SETUP);
+	uint8_t setup = nRF24_readRegister(dev, RF_SETUP);
 	setup &= ~((1<<RF_DR));
 	
 	if (speed == RF24_2MBPS) {
 		setup |= (1<<RF_DR);
 		#if !defined(F_CPU)
-		txDelay = 190;
+		dev->txDelay = 190;
 		#else // 16Mhz Arduino
-		txDelay = 65;
+		dev->txDelay = 65;
 		#endif
 	}
-	nRF24_writeRegister(RF_SETUP, setup);
+	nRF24_writeRegister(dev, RF_SETUP, setup);
 	
-	if(nRF24_readRegister(RF_SETUP) == setup)
+	if(readRegisterDirect(dev, RF_SETUP) == setup)
 	result = true;
 	
 	return result;
@@ -174,10 +275,10 @@ bool nRF24_setDataRate(rf24_datarate_e speed)
  * 
  * \return datarate
  */
-rf24_datarate_e getDataRate(void)
+rf24_datarate_e getDataRate(nrf24_t *dev)
 {
 	rf24_datarate_e result;
-	uint8_t dr = nRF24_readRegister(RF_SETUP) & ((1<<RF_DR_LOW) | (1<<RF_DR_HIGH));
+	uint8_t dr = nRF24_readRegister(dev, RF_SETUP) & ((1<<RF_DR_LOW) | (1<<RF_DR_HIGH));
 	
 	if (dr == (1<<RF_DR_HIGH)) {
 		// '01' = 2MBPS
@@ -196,9 +297,9 @@ rf24_datarate_e getDataRate(void)
  * \param length length of the decoding
  *
  */
-void nRF24_setCRCLength(rf24_crclength_e length)
+void nRF24_setCRCLength(nrf24_t *dev, rf24_crclength_e length)
 {
-	uint8_t config = nRF24_readRegister(NRF_CONFIG) & ~((1<<CRCO) | (1<<EN_CRC));
+	uint8_t config = nRF24_readRegister(dev, NRF_CONFIG) & ~((1<<CRCO) | (1<<EN_CRC));
 	
 	if (length == RF24_CRC_DISABLED){
 		// do nothing we turned it off above
@@ -211,7 +312,7 @@ void nRF24_setCRCLength(rf24_crclength_e length)
 		config |= (1<<EN_CRC);
 		config |= (1<<CRCO);
 	}
-	nRF24_writeRegister(NRF_CONFIG, config);
+	nRF24_writeRegister(dev, NRF_CONFIG, config);
 }
 
 /**
@@ -219,12 +320,12 @@ void nRF24_setCRCLength(rf24_crclength_e length)
  * 
  * \return CRC length
  */
-rf24_crclength_e getCRCLength(void)
+rf24_crclength_e getCRCLength(nrf24_t *dev)
 {
 	rf24_crclength_e result = RF24_CRC_DISABLED;
 	
-	uint8_t config = nRF24_readRegister(NRF_CONFIG) & ((1<<CRCO) | (1<<EN_CRC));
-	uint8_t AA = nRF24_readRegister(EN_AA);
+	uint8_t config = nRF24_readRegister(dev, NRF_CONFIG) & ((1<<CRCO) | (1<<EN_CRC));
+	uint8_t AA = nRF24_readRegister(dev, EN_AA);
 	
     if (config & (1<<EN_CRC) || AA) {
 	    if (config & (1<<CRCO)) {
@@ -244,9 +345,9 @@ rf24_crclength_e getCRCLength(void)
  * \param level: the desired power output (-18, -12, -6 or 0dBm )
  *
  */
-void nRF24_setPALevel(uint8_t level)
+void nRF24_setPALevel(nrf24_t *dev, uint8_t level)
 {
-	uint8_t setup = nRF24_readRegister(RF_SETUP) & 0xF8;
+	uint8_t setup = nRF24_readRegister(dev, RF_SETUP) & 0xF8;
 	
 	
 	if (level > 3) {
@@ -254,7 +355,7 @@ void nRF24_setPALevel(uint8_t level)
 	} else {
 		level = (level << 1) + 1;
 	}
-	nRF24_writeRegister(RF_SETUP, setup |= level);
+	nRF24_writeRegister(dev, RF_SETUP, setup |= level);
 }
 
 /**
@@ -262,9 +363,9 @@ void nRF24_setPALevel(uint8_t level)
  * 
  * \return PA level
  */
-uint8_t nRF24_getPALevel(void)
+uint8_t nRF24_getPALevel(nrf24_t *dev)
 {
-	return (nRF24_readRegister(RF_SETUP) & (1<<(RF_PWR_LOW) | (1<<RF_PWR_HIGH))) >> 1;
+	return (nRF24_readRegister(dev, RF_SETUP) & (1<<(RF_PWR_LOW) | (1<<RF_PWR_HIGH))) >> 1;
 }
 
 static bool isPVariant(void)
@@ -277,15 +378,16 @@ static void print_status (uint8_t status)
 	printf("STATUS\t\t = 0x%02x RX_DR=%x TX_DS=%x MAX_RT=%x RX_P_NO=%x TX_FULL=%x\r\n", status, (status & (1<<RX_DR)) ? 1 : 0, (status & (1<<TX_DS)) ? 1 : 0, (status & (1<<MAX_RT)) ? 1 : 0, (status & (1<<RX_P_NO)) ? 1 : 0, (status & (1<<TX_FULL)) ? 1 : 0);
 }
 
-static void print_address_register(const char* name, uint8_t reg, uint8_t qty)
+static void print_address_register(nrf24_t *dev, const char* name, uint8_t reg, uint8_t qty)
 {
+	uint8_t buffer[5]; //widest address
+	
 	printf("%s\t", name);
 	while(qty--){
-		uint8_t buffer[addr_width];
-		read_register(reg++, buffer, sizeof(buffer));
+		read_register(dev, reg++, buffer, dev->addr_width);
 		
 		printf(" 0x");
-		uint8_t* bufptr = buffer + sizeof(buffer);
+		uint8_t* bufptr = buffer + dev->addr_width;
 		while(--bufptr >= buffer){
 			printf("%02x", *bufptr);
 		}
@@ -293,37 +395,37 @@ static void print_address_register(const char* name, uint8_t reg, uint8_t qty)
 	printf("\r\n");
 }
 
-static void print_byte_register(const char* name, uint8_t reg, uint8_t qty)
+static void print_byte_register(nrf24_t *dev, const char* name, uint8_t reg, uint8_t qty)
 {
 	printf("%s\t", name);
 	while (qty--)
 	{
-		printf(" 0x%02x", nRF24_readRegister(reg++));
+		printf(" 0x%02x", readRegisterDirect(dev, reg++));
 	}
 	printf("\r\n");
 }
 
-void printDetails(void)
+void printDetails(nrf24_t *dev)
 {
-	printf("SPI Speed\t = %ld MHz\r\n",gs_ul_spi_clock/1000000);
-	print_status(nRF24_getStatus());
-	print_address_register("RX_ADDR_P0-1", RX_ADDR_P0, 2);
-	print_byte_register("RX_ADDR_P2-5", RX_ADDR_P2, 4);
-	print_address_register("TX_ADDR\t", TX_ADDR, 1);
+	printf("SPI Speed\t = %ld kHz\r\n", (long)(spi_get_clock(dev->spi_cs) / 1000));
+	print_status(nRF24_getStatus(dev));
+	print_address_register(dev, "RX_ADDR_P0-1", RX_ADDR_P0, 2);
+	print_byte_register(dev, "RX_ADDR_P2-5", RX_ADDR_P2, 4);
+	print_address_register(dev, "TX_ADDR\t", TX_ADDR, 1);
 
-	print_byte_register("RX_PW_P0-5", RX_PW_P0, 6);
-	print_byte_register("SETUP_AW", SETUP_AW, 1);
-	print_byte_register("EN_AA\t", EN_AA, 1);
-	print_byte_register("EN_RXADDR", EN_RXADDR, 1);
-	print_byte_register("RF_CH\t", RF_CH, 1);
-	print_byte_register("RF_SETUP", RF_SETUP, 1);
-	print_byte_register("CONFIG\t", NRF_CONFIG, 1);
-	print_byte_register("DYNPD/FEATURE", DYNPD, 2);
+	print_byte_register(dev, "RX_PW_P0-5", RX_PW_P0, 6);
+	print_byte_register(dev, "SETUP_AW", SETUP_AW, 1);
+	print_byte_register(dev, "EN_AA\t", EN_AA, 1);
+	print_byte_register(dev, "EN_RXADDR", EN_RXADDR, 1);
+	print_byte_register(dev, "RF_CH\t", RF_CH, 1);
+	print_byte_register(dev, "RF_SETUP", RF_SETUP, 1);
+	print_byte_register(dev, "CONFIG\t", NRF_CONFIG, 1);
+	print_byte_register(dev, "DYNPD/FEATURE", DYNPD, 2);
 	
-	printf("Data Rate\t = %s\r\n", rf24_datarate_e_str_P[getDataRate()]);
+	printf("Data Rate\t = %s\r\n", rf24_datarate_e_str_P[getDataRate(dev)]);
 	printf("Model\t\t = %s\r\n", rf24_model_e_str_P[isPVariant()]);
-	printf("CRC Length\t = %s\r\n", rf24_crclength_e_str_P[getCRCLength()]);
-	printf("PA Power\t = %s\r\n", rf24_pa_dbm_e_str_P[nRF24_getPALevel()]);
+	printf("CRC Length\t = %s\r\n", rf24_crclength_e_str_P[getCRCLength(dev)]);
+	printf("PA Power\t = %s\r\n", rf24_pa_dbm_e_str_P[nRF24_getPALevel(dev)]);
 }
 
 /**
@@ -335,11 +437,11 @@ void printDetails(void)
  * 
  * \return STATUS
  */
-static uint8_t writePayload(const void* buf, uint8_t data_len, const uint8_t writeType)
+static uint8_t writePayload(nrf24_t *dev, const void* buf, uint8_t data_len, const uint8_t writeType)
 {
-	uint8_t blanklen = dynamic_payloads_enabled ? 0 : payload_size - data_len;
+	uint8_t blanklen = dev->dynamic_payloads_enabled ? 0 : dev->payload_size - data_len;
 	uint8_t size = data_len + blanklen + 1;
-	uint8_t s_buff[size];
+	uint8_t *s_buff = spiBuffer();
 	uint8_t* current = (uint8_t*) buf;
 /*	
 	#ifdef _DEBUG
@@ -349,10 +451,10 @@ static uint8_t writePayload(const void* buf, uint8_t data_len, const uint8_t wri
 	s_buff[0] = writeType;
 	for (uint8_t i = 1; i< size; i++)
 	{
-		s_buff[i] = current[i-1];
+		s_buff[i] = (i <= data_len) ? current[i-1] : 0;
 	}
 	
-	spi_master_transfer(s_buff, size);
+	spi_master_transfer_cs(dev->spi_cs, s_buff, size);
 
 	return s_buff[0];
 }
@@ -365,11 +467,11 @@ static uint8_t writePayload(const void* buf, uint8_t data_len, const uint8_t wri
  * \param multicast true or false
  * 
  */
-static void startFastWrite(const void* buf, uint8_t len, const bool multicast)
+static void startFastWrite(nrf24_t *dev, const void* buf, uint8_t len, const bool multicast)
 {
-	writePayload(buf, len, multicast ? W_TX_PAYLOAD_NO_ACK : W_TX_PAYLOAD); // ?: operator a ? b : c // if a, b else c
+	writePayload(dev, buf, len, multicast ? W_TX_PAYLOAD_NO_ACK : W_TX_PAYLOAD); // ?: operator a ? b : c // if a, b else c
 
-	ioport_set_pin_level(CE, 1);
+	ioport_set_pin_level(dev->ce, 1);
 }
 
 /**
@@ -381,19 +483,19 @@ static void startFastWrite(const void* buf, uint8_t len, const bool multicast)
  * 
  * \return true if TX complete
  */
-static bool nRFwrite(const void* buf, uint8_t len, const bool multicast)
+static bool nRFwrite(nrf24_t *dev, const void* buf, uint8_t len, const bool multicast)
 {
-	startFastWrite(buf, len, multicast);
+	startFastWrite(dev, buf, len, multicast);
 	
-	while(!(nRF24_getStatus() & ((1<<TX_DS) | (1<<MAX_RT))))
+	while(!(nRF24_getStatus(dev) & ((1<<TX_DS) | (1<<MAX_RT))))
 	{
 		delay_us(100);
 	}
-	ioport_set_pin_level(CE, 0);
-	uint8_t status = nRF24_writeRegister(NRF_STATUS, (1<<RX_DR) | (1<<TX_DS) | (1<<MAX_RT));
+	ioport_set_pin_level(dev->ce, 0);
+	uint8_t status = nRF24_writeRegister(dev, NRF_STATUS, (1<<RX_DR) | (1<<TX_DS) | (1<<MAX_RT));
 	
 	if(status & (1<<MAX_RT)){
-		nRF24_FlushTx();
+		nRF24_FlushTx(dev);
 		return 0;
 	}
 	return 1;
@@ -405,9 +507,9 @@ static bool nRFwrite(const void* buf, uint8_t len, const bool multicast)
  * \param pipe RX pipe to close
  *
  */
-void nRF24_closeReadingPipe(uint8_t pipe)
+void nRF24_closeReadingPipe(nrf24_t *dev, uint8_t pipe)
  {
-	 nRF24_writeRegister(EN_RXADDR, nRF24_readRegister(EN_RXADDR) & ~(1<< pipe_enable_s[pipe]));
+	 nRF24_writeRegister(dev, EN_RXADDR, nRF24_readRegister(dev, EN_RXADDR) & ~(1<< pipe_enable_s[pipe]));
  }
  
  /**
@@ -418,12 +520,12 @@ void nRF24_closeReadingPipe(uint8_t pipe)
  * 
  * \return STATUS
  */
-static uint8_t readPayload(uint8_t* buf, uint8_t data_len)
+static uint8_t readPayload(nrf24_t *dev, uint8_t* buf, uint8_t data_len)
 {
-	uint8_t s_buff[data_len+1];
+	uint8_t *s_buff = spiBuffer();
 	
-	if (data_len > payload_size){
-		data_len = payload_size;
+	if (data_len > dev->payload_size){
+		data_len = dev->payload_size;
 	}
 	s_buff[0] = R_RX_PAYLOAD;
 	
@@ -432,7 +534,7 @@ static uint8_t readPayload(uint8_t* buf, uint8_t data_len)
 		s_buff[i] = 0xFF;
 	}
 	
-	spi_master_transfer(s_buff, sizeof(s_buff));
+	spi_master_transfer_cs(dev->spi_cs, s_buff, data_len + 1);
 	
 	for (uint8_t i = 0; i< data_len; i++)
 	{
@@ -448,14 +550,15 @@ static uint8_t readPayload(uint8_t* buf, uint8_t data_len)
  * \param width address width
  *
  */
-void nRF24_setAddressWidth(uint8_t width)
+void nRF24_setAddressWidth(nrf24_t *dev, uint8_t width)
 {
+	dev->addr_shadow_valid = 0;
 	if (width -= 2){
-		nRF24_writeRegister(SETUP_AW, width % 4);
-		addr_width = (width % 4) + 2;
+		nRF24_writeRegister(dev, SETUP_AW, width % 4);
+		dev->addr_width = (width % 4) + 2;
 		} else {
-		nRF24_writeRegister(SETUP_AW, 0);
-		addr_width = 2;
+		nRF24_writeRegister(dev, SETUP_AW, 0);
+		dev->addr_width = 2;
 	}
 }
 
@@ -466,20 +569,22 @@ void nRF24_setAddressWidth(uint8_t width)
  * \param count amount of retries permitted
  *
  */
-void nRF24_setRetries(uint8_t delay, uint8_t count)
+void nRF24_setRetries(nrf24_t *dev, uint8_t delay, uint8_t count)
 {
-	nRF24_writeRegister(SETUP_RETR, (delay & 0xF) << ARD | (count & 0xF) <<ARC );
+	nRF24_writeRegister(dev, SETUP_RETR, (delay & 0xF) << ARD | (count & 0xF) <<ARC );
 }
 
 /**
  * \brief toggels ACK features
  *
  */
-void toggle_features(void)
+void toggle_features(nrf24_t *dev)
 {
-	uint8_t config[2] = {ACTIVATE, 0x73};
+	uint8_t *config = spiBuffer();
 	
-	spi_master_transfer(config, sizeof(config));
+	config[0] = ACTIVATE;
+	config[1] = 0x73;
+	spi_master_transfer_cs(dev->spi_cs, config, 2);
 }
 
 /**
@@ -488,25 +593,133 @@ void toggle_features(void)
  * \param channel ferquency channel used
  *
  */
-void nRF24_setChannel(uint8_t channel)
+void nRF24_setChannel(nrf24_t *dev, uint8_t channel)
 {
 	const uint8_t max_channel = 125;
 	if (channel > max_channel)
-		nRF24_writeRegister(RF_CH, max_channel);
-	else
-		nRF24_writeRegister(RF_CH, channel);
+		channel = max_channel;
+	dev->tx_channel = channel;
+	nRF24_writeRegister(dev, RF_CH, channel);
+}
+
+/**
+ * \brief fetch the frequency channel used for transmission
+ * 
+ * \return channel
+ */
+uint8_t nRF24_getChannel(nrf24_t *dev)
+{
+	return nRF24_readRegister(dev, RF_CH);
+}
+
+/**
+ * \brief pick the quietest channel from a survey histogram
+ * A channel is scored with its 2 neighbours on each side, a Wi-Fi channel covers ~20 channels.
+ * 
+ * \param histogram: NRF24_CHANNELS counters of RPD hits, see nRF24_surveyChannels()
+ * \param avoid: channels already in use by other radios, can be NULL
+ * \param avoid_count: number of channels in avoid
+ * \param spacing: minimum distance to the channels in avoid
+ *
+ * \return quietest channel, 0xFF when every channel is too close to avoid
+ */
+uint8_t nRF24_pickChannel(const uint8_t* histogram, const uint8_t* avoid, uint8_t avoid_count, uint8_t spacing)
+{
+	uint8_t best = 0xFF;
+	uint16_t best_score = 0xFFFF;
+	uint16_t score;
+	uint8_t ch;
+	uint8_t a;
+	int8_t i;
+	
+	for (ch = 0; ch < NRF24_CHANNELS; ch++)
+	{
+		for (a = 0; a < avoid_count; a++)
+		{
+			if (abs(ch - avoid[a]) < spacing)
+			{
+				break;
+			}
+		}
+		if (a != avoid_count)
+		{
+			continue;
+		}
+		score = 0;
+		for (i = -2; i <= 2; i++)
+		{
+			if ((ch + i >= 0) && (ch + i < NRF24_CHANNELS))
+			{
+				score += histogram[ch + i] * ((i == 0) ? 2 : 1);
+			}
+		}
+		if (score < best_score)
+		{
+			best_score = score;
+			best = ch;
+		}
+	}
+	return best;
+}
+
+/**
+ * \brief survey the frequency channels and pick the quietest one
+ * Every sweep listens shortly on each channel and counts how often RPD (received power > -64dBm) is set.
+ * The quietest channel is picked by nRF24_pickChannel().
+ * The module must not be transmitting, it is left as transmitter on the original channel.
+ * 
+ * \param histogram: NRF24_CHANNELS counters filled with the RPD hits per channel, can be NULL
+ * \param sweeps: number of sweeps over all channels (~25ms each)
+ *
+ * \return quietest channel
+ */
+uint8_t nRF24_surveyChannels(nrf24_t *dev, uint8_t* histogram, uint8_t sweeps)
+{
+	uint8_t hits[NRF24_CHANNELS];
+	uint8_t channel = nRF24_getChannel(dev);
+	uint8_t config = nRF24_readRegister(dev, NRF_CONFIG);
+	uint8_t ch;
+	
+	memset(hits, 0, sizeof(hits));
+	ioport_set_pin_level(dev->ce, 0);
+	nRF24_powerUp(dev);
+	nRF24_writeRegister(dev, NRF_CONFIG, nRF24_readRegister(dev, NRF_CONFIG) | (1<<PRIM_RX));
+	
+	while (sweeps--)
+	{
+		for (ch = 0; ch < NRF24_CHANNELS; ch++)
+		{
+			nRF24_setChannel(dev, ch);
+			ioport_set_pin_level(dev->ce, 1);
+			delay_us(RPD_SETTLE_US);
+			if ((readRegisterDirect(dev, RPD) & 0x01) && (hits[ch] < 0xFF))
+			{
+				hits[ch]++;
+			}
+			ioport_set_pin_level(dev->ce, 0);
+		}
+	}
+	
+	nRF24_writeRegister(dev, NRF_CONFIG, config);
+	nRF24_setChannel(dev, channel);
+	
+	if (histogram)
+	{
+		memcpy(histogram, hits, sizeof(hits));
+	}
+	return nRF24_pickChannel(hits, NULL, 0, 0);
 }
 
 /**
  * \brief power up the internal logic of the nRF24 chip
  * 
  */
-void nRF24_powerUp(void)
+void nRF24_powerUp(nrf24_t *dev)
 {
-	uint8_t config = nRF24_readRegister(NRF_CONFIG);
+	uint8_t config = nRF24_readRegister(dev, NRF_CONFIG);
 	
 	if (!(config & (1<<PWR_UP))){
-		nRF24_writeRegister(NRF_CONFIG, config | (1<<PWR_UP));
+		nRF24_writeRegister(dev, NRF_CONFIG, config | (1<<PWR_UP));
 		delay_ms(5);
 	}
 }
@@ -515,33 +728,35 @@ void nRF24_powerUp(void)
  * \brief Power down the internal logic of the nRF24 chip
  *
  */
-void nRF24_powerDown(void)
+void nRF24_powerDown(nrf24_t *dev)
 {
-	ioport_set_pin_level(CE, 0);
-	nRF24_writeRegister(NRF_CONFIG, nRF24_readRegister(NRF_CONFIG) & ~(1<<PWR_UP));
+	ioport_set_pin_level(dev->ce, 0);
+	nRF24_writeRegister(dev, NRF_CONFIG, nRF24_readRegister(dev, NRF_CONFIG) & ~(1<<PWR_UP));
 }
 
 /**
  * \brief use the nRF24 module as receiver and listen for transmissions
  *
  */
-void nRF24_startListening(void)
+void nRF24_startListening(nrf24_t *dev)
 {
-	nRF24_powerUp();
+	nRF24_powerUp(dev);
 	
-	nRF24_writeRegister(NRF_CONFIG, nRF24_readRegister(NRF_CONFIG) | (1<<PRIM_RX)); 
-	nRF24_writeRegister(NRF_STATUS, (1<<RX_DR) | (1<<TX_DS) | (1<<MAX_RT));
+	nRF24_writeRegister(dev, NRF_CONFIG, nRF24_readRegister(dev, NRF_CONFIG) | (1<<PRIM_RX)); 
+	nRF24_writeRegister(dev, NRF_STATUS, (1<<RX_DR) | (1<<TX_DS) | (1<<MAX_RT));
 	
-	ioport_set_pin_level(CE, 1);
+	ioport_set_pin_level(dev->ce, 1);
 	
-	if (pipe0_reading_address[0] > 0){
-		writeRegister(RX_ADDR_P0, pipe0_reading_address, addr_width);
+	if (dev->pipe0_reading_address[0] > 0){
+		uint64_t address = 0;
+		memcpy(&address, dev->pipe0_reading_address, dev->addr_width);
+		writeAddress(dev, RX_ADDR_P0, address);
 	} else {
-		nRF24_closeReadingPipe(0);
+		nRF24_closeReadingPipe(dev, 0);
 	}
 	
-	if (nRF24_readRegister(FEATURE) & (1<<EN_ACK_PAY)){
-		nRF24_FlushTx();
+	if (nRF24_readRegister(dev, FEATURE) & (1<<EN_ACK_PAY)){
+		nRF24_FlushTx(dev);
 	}
 }
 
@@ -549,22 +764,208 @@ void nRF24_startListening(void)
  * \brief use the nRF24 module as transmitter
  *
  */
-void nRF24_stopListening(void)
+void nRF24_stopListening(nrf24_t *dev)
 {
-	ioport_set_pin_level(CE, 0);
+	ioport_set_pin_level(dev->ce, 0);
 	
-	delay_us(txDelay);
-	if (nRF24_readRegister(FEATURE) & 1<<(EN_ACK_PAY))
+	delay_us(dev->txDelay);
+	if (nRF24_readRegister(dev, FEATURE) & 1<<(EN_ACK_PAY))
 	{
-		delay_us(txDelay);
-		nRF24_FlushTx();
+		delay_us(dev->txDelay);
+		nRF24_FlushTx(dev);
 	}
-	nRF24_writeRegister(NRF_CONFIG, (nRF24_readRegister(NRF_CONFIG)) & ~(1<<PRIM_RX));
-	nRF24_writeRegister(EN_RXADDR, nRF24_readRegister(EN_RXADDR) | (1<< pipe_enable_s[0])); 
+	nRF24_writeRegister(dev, NRF_CONFIG, (nRF24_readRegister(dev, NRF_CONFIG)) & ~(1<<PRIM_RX));
+	nRF24_writeRegister(dev, EN_RXADDR, nRF24_readRegister(dev, EN_RXADDR) | (1<< pipe_enable_s[0])); 
+}
+
+/**
+ * \brief allow payloads without acknowledgment (W_TX_PAYLOAD_NO_ACK)
+ * Needed for multicast writes, the receivers do not need this setting.
+ *
+ */
+void nRF24_enableDynamicAck(nrf24_t *dev)
+{
+	nRF24_writeRegister(dev, FEATURE, nRF24_readRegister(dev, FEATURE) | (1<<EN_DYN_ACK));
+}
+
+/**
+ * \brief enable dynamic payload length on all pipes
+ * Payloads are no longer padded to payload_size, the receivers must enable it as well.
+ *
+ */
+void nRF24_enableDynamicPayloads(nrf24_t *dev)
+{
+	nRF24_writeRegister(dev, FEATURE, nRF24_readRegister(dev, FEATURE) | (1<<EN_DPL));
+	nRF24_writeRegister(dev, DYNPD, (1<<DPL_P5) | (1<<DPL_P4) | (1<<DPL_P3) | (1<<DPL_P2) | (1<<DPL_P1) | (1<<DPL_P0));
+	
+	dev->dynamic_payloads_enabled = true;
+}
+
+/**
+ * \brief disable dynamic payload length, payloads are padded to payload_size
+ *
+ */
+void nRF24_disableDynamicPayloads(nrf24_t *dev)
+{
+	nRF24_writeRegister(dev, FEATURE, nRF24_readRegister(dev, FEATURE) & ~(1<<EN_DPL));
+	nRF24_writeRegister(dev, DYNPD, 0);
+	
+	dev->dynamic_payloads_enabled = false;
+}
+
+/**
+ * \brief accept payloads in the ACK packets of the receivers (EN_ACK_PAY)
+ * Requires dynamic payloads. nRF24_write() leaves an ACK payload in the RX FIFO
+ * (nRF24_available(), nRF24_read()), the TX engine passes it to its callback.
+ *
+ */
+void nRF24_enableAckPayload(nrf24_t *dev)
+{
+	if (!dev->dynamic_payloads_enabled)
+	{
+		nRF24_enableDynamicPayloads(dev);
+	}
+	nRF24_writeRegister(dev, FEATURE, nRF24_readRegister(dev, FEATURE) | (1<<EN_ACK_PAY));
+}
+
+/**
+ * \brief fetch the length of the payload on top of the RX FIFO (R_RX_PL_WID)
+ * A corrupt length (> 32) flushes the RX FIFO.
+ * 
+ * \return payload length, 0 if corrupt
+ */
+uint8_t nRF24_getDynamicPayloadSize(nrf24_t *dev)
+{
+	uint8_t *cmd = spiBuffer();
+	
+	cmd[0] = R_RX_PL_WID;
+	cmd[1] = 0xFF;
+	spi_master_transfer_cs(dev->spi_cs, cmd, 2);
+	
+	if (cmd[1] > 32)
+	{
+		nRF24_FlushRx(dev);
+		return 0;
+	}
+	return cmd[1];
+}
+
+/**
+ * \brief write/readback test of the SPI link
+ * Walks patterns with many edges through TX_ADDR and RX_ADDR_P1, the caller restores both.
+ * 
+ * \return true if every pattern was read back unchanged
+ */
+static bool spiLinkTest(nrf24_t *dev)
+{
+	static const uint8_t patterns[] = {0x55, 0xAA, 0x00, 0xFF, 0x0F, 0xF0, 0x69, 0x96};
+	uint8_t tx[5];
+	uint8_t rx[5];
+	uint8_t round;
+	uint8_t p;
+	uint8_t i;
+	
+	for (round = 0; round < SPI_CAL_ROUNDS; round++)
+	{
+		for (p = 0; p < sizeof(patterns); p++)
+		{
+			for (i = 0; i < dev->addr_width; i++)
+			{
+				tx[i] = patterns[(p + i) % sizeof(patterns)] ^ round;
+			}
+			writeRegister(dev, TX_ADDR, tx, dev->addr_width);
+			writeRegister(dev, RX_ADDR_P1, tx, dev->addr_width);
+			read_register(dev, TX_ADDR, rx, dev->addr_width);
+			if (memcmp(tx, rx, dev->addr_width))
+			{
+				return false;
+			}
+			read_register(dev, RX_ADDR_P1, rx, dev->addr_width);
+			if (memcmp(tx, rx, dev->addr_width))
+			{
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+/**
+ * \brief calibrate the SPI clock and chip select delays of the radio
+ * Steps the SPI clock up and for every clock tightens the chip select delays while spiLinkTest() passes.
+ * A clock passes when its tightest passing delays leave one more conservative step as margin
+ * (or when even the tightest delays pass). The clock one step below the fastest passing one
+ * is used with its delays, the slowest clock keeps no clock margin when it is the only one passing.
+ * Call after nRF24_begin(), TX_ADDR and RX_ADDR_P1 are restored.
+ * 
+ * \return SPI clock (Hz)
+ */
+uint32_t nRF24_calibrateSpi(nrf24_t *dev)
+{
+	uint8_t tx_addr[5];
+	uint8_t p1_addr[5];
+	uint8_t pass_delay[NUM_SPCK_CONFIGURATIONS];
+	uint8_t pass_count = 0;
+	uint8_t best_clock = 0;
+	uint8_t best_delay = 0;
+	uint8_t clock;
+	int8_t delay;
+	
+	spi_set_clock_configuration(dev->spi_cs, 0);
+	spi_set_delay_configuration(dev->spi_cs, 0);
+	read_register(dev, TX_ADDR, tx_addr, sizeof(tx_addr));
+	read_register(dev, RX_ADDR_P1, p1_addr, sizeof(p1_addr));
+	
+	for (clock = 0; clock < NUM_SPCK_CONFIGURATIONS; clock++)
+	{
+		spi_set_clock_configuration(dev->spi_cs, clock);
+		for (delay = 0; delay < NUM_DELAY_CONFIGURATIONS; delay++)
+		{
+			spi_set_delay_configuration(dev->spi_cs, delay);
+			if (!spiLinkTest(dev))
+			{
+				break;
+			}
+		}
+		delay--; //tightest passing delays
+		if (delay == NUM_DELAY_CONFIGURATIONS - 1)
+		{
+			pass_delay[pass_count++] = delay;
+		}
+		else if (delay > 0)
+		{
+			pass_delay[pass_count++] = delay - 1;
+			break; //a faster clock will not do better
+		}
+		else
+		{
+			break;
+		}
+	}
+	
+	//clock margin: back off one step from the fastest passing clock
+	if (pass_count > 1)
+	{
+		best_clock = pass_count - 2;
+		best_delay = pass_delay[best_clock];
+	}
+	else if (pass_count == 1)
+	{
+		best_delay = pass_delay[0];
+	}
+	
+	spi_set_clock_configuration(dev->spi_cs, best_clock);
+	spi_set_delay_configuration(dev->spi_cs, best_delay);
+	writeRegister(dev, TX_ADDR, tx_addr, sizeof(tx_addr));
+	writeRegister(dev, RX_ADDR_P1, p1_addr, sizeof(p1_addr));
+	nRF24_invalidateShadow(dev);
+	
+	return spi_get_clock(dev->spi_cs);
 }
 
 /**
  * \brief configure I/O to be used by nRF24 module and configure the internal logic of the nRF24 as followed:
+ * The pins of dev (spi_cs, ce, irq_*) must be filled in, see NRF24_DEVICE().
  *
  * TX retries(5, 15): delay 1,25ms (5*250us), 15 retries
  * Data rate: 1MBPS
@@ -574,32 +975,40 @@ void nRF24_stopListening(void)
  * 
  * \return 1 if nRF24 module reacts to data
  */
-bool nRF24_begin(void)
+bool nRF24_begin(nrf24_t *dev)
 {
 	uint8_t setup = 0;
-	ioport_set_pin_dir(CE, IOPORT_DIR_OUTPUT);//ce_pin PC9
-	ioport_set_pin_level(CE, 0);
+	ioport_set_pin_dir(dev->ce, IOPORT_DIR_OUTPUT);
+	ioport_set_pin_level(dev->ce, 0);
+	spi_master_setup_cs(dev->spi_cs);
+	
+	dev->payload_size = 32;
+	dev->dynamic_payloads_enabled = false;
+	memset(dev->pipe0_reading_address, 0, sizeof(dev->pipe0_reading_address));
+	dev->tx_pending = 0;
+	dev->tx_active = NRF24_TX_NONE;
 	
-	nRF24_writeRegister(NRF_CONFIG, 0x0C);
-	nRF24_setRetries(5, 15);
+	nRF24_invalidateShadow(dev);
+	nRF24_writeRegister(dev, NRF_CONFIG, 0x0C);
+	nRF24_setRetries(dev, 5, 15);
 	
-	nRF24_setDataRate(RF24_1MBPS);
-	nRF24_setCRCLength(RF24_CRC_16);
-	toggle_features();
+	nRF24_setDataRate(dev, RF24_1MBPS);
+	nRF24_setCRCLength(dev, RF24_CRC_16);
+	toggle_features(dev);
 	
 	//reset current status
-	nRF24_writeRegister(NRF_STATUS, (1<<RX_DR) | (1<<TX_DS) | (1<<MAX_RT));
+	nRF24_writeRegister(dev, NRF_STATUS, (1<<RX_DR) | (1<<TX_DS) | (1<<MAX_RT));
 	
-	nRF24_setChannel(76);
-	nRF24_setAddressWidth(ADDR_4bytes);
+	nRF24_setChannel(dev, 76);
+	nRF24_setAddressWidth(dev, ADDR_4bytes);
 	
-	nRF24_FlushRx();
-	nRF24_FlushTx();
+	nRF24_FlushRx(dev);
+	nRF24_FlushTx(dev);
 	
-	nRF24_powerUp();
+	nRF24_powerUp(dev);
 	
-	nRF24_writeRegister(NRF_CONFIG, (nRF24_readRegister(NRF_CONFIG)) & ~(1<<PRIM_RX));
-	setup = nRF24_readRegister(RF_SETUP);
+	nRF24_writeRegister(dev, NRF_CONFIG, (nRF24_readRegister(dev, NRF_CONFIG)) & ~(1<<PRIM_RX));
+	setup = readRegisterDirect(dev, RF_SETUP);
 	
 	return (setup != 0 && setup != 0xFF);
 }
@@ -607,16 +1016,17 @@ bool nRF24_begin(void)
 /**
  * \brief Opens TX pipe with given address
  * this Should be the same as the RX0 pipe of receiver
+ * Only the registers that change are written, reopening the current address costs no SPI transfer.
  * 
  * \param address address of the receiving module
  *
  */
-void nRF24_openWritingPipe(uint64_t address)
+void nRF24_openWritingPipe(nrf24_t *dev, uint64_t address)
 {
-	writeRegister(RX_ADDR_P0, (uint8_t *)(&address), addr_width);
-	writeRegister(TX_ADDR, (uint8_t *)(&address), addr_width);
+	writeAddress(dev, RX_ADDR_P0, address);
+	writeAddress(dev, TX_ADDR, address);
 	
-	nRF24_writeRegister(RX_PW_P0, payload_size);
+	nRF24_writeRegister(dev, RX_PW_P0, dev->payload_size);
 }
 
 /**
@@ -625,14 +1035,14 @@ void nRF24_openWritingPipe(uint64_t address)
  * \param size size of the RX/TX buffers
  *
  */
-void nRF24_setPayloadSize(uint8_t size)
+void nRF24_setPayloadSize(nrf24_t *dev, uint8_t size)
 {
 	const uint8_t max_size = 32;
 	
 	if (size > max_size)
-		payload_size = 32;
+		dev->payload_size = 32;
 	else
-		payload_size = size;
+		dev->payload_size = size;
 }
 
 /**
@@ -641,9 +1051,9 @@ void nRF24_setPayloadSize(uint8_t size)
  * \return buffer size
  *
  */
-uint8_t nRF24_getpayloadSize(void)
+uint8_t nRF24_getpayloadSize(nrf24_t *dev)
 {
-	return payload_size;
+	return dev->payload_size;
 }
 
 /**
@@ -653,20 +1063,22 @@ uint8_t nRF24_getpayloadSize(void)
  * \param address address of the transmitting module
  *
  */
-void nRF24_openReadingPipe(uint8_t pipe, uint64_t address)
+void nRF24_openReadingPipe(nrf24_t *dev, uint8_t pipe, uint64_t address)
 {	
 	if (pipe == 0){
-		memcpy(pipe0_reading_address, &address, addr_width);
+		memcpy(dev->pipe0_reading_address, &address, dev->addr_width);
 	}
 	if (pipe <= 5){
-		if (pipe < 2){
-			writeRegister(pipe_s[pipe], (const uint8_t *) (&address), addr_width);
+		if (pipe == 0){
+			writeAddress(dev, RX_ADDR_P0, address);
+		} else if (pipe < 2){
+			writeRegister(dev, pipe_s[pipe], (const uint8_t *) (&address), dev->addr_width);
 		} else {
-			writeRegister(pipe_s[pipe], (const uint8_t *) (&address), 1);
+			writeRegister(dev, pipe_s[pipe], (const uint8_t *) (&address), 1);
 		}
-		nRF24_writeRegister(pipe_size_s[pipe], payload_size);
+		nRF24_writeRegister(dev, pipe_size_s[pipe], dev->payload_size);
 	}
-	nRF24_writeRegister(EN_RXADDR, nRF24_readRegister(EN_RXADDR) | (1 << pipe_enable_s[pipe]));
+	nRF24_writeRegister(dev, EN_RXADDR, nRF24_readRegister(dev, EN_RXADDR) | (1 << pipe_enable_s[pipe]));
 }
 
 /**
@@ -676,13 +1088,13 @@ void nRF24_openReadingPipe(uint8_t pipe, uint64_t address)
  *
  * \return true or false
  */
-bool nRF24_available(uint8_t* pipe_num)
+bool nRF24_available(nrf24_t *dev, uint8_t* pipe_num)
 {
-	if (!(nRF24_readRegister(FIFO_STATUS) & (1<<RX_EMPTY)))
+	if (!(nRF24_readRegister(dev, FIFO_STATUS) & (1<<RX_EMPTY)))
 	{
 		if(pipe_num)
 		{
-			uint8_t status = nRF24_getStatus();
+			uint8_t status = nRF24_getStatus(dev);
 			*pipe_num = (status >> RX_P_NO) & 0x07;
 		}
 		return 1;
@@ -697,22 +1109,378 @@ bool nRF24_available(uint8_t* pipe_num)
  * \param len: length of the payload to be read
  *
  */
-void nRF24_read(uint8_t* buf, uint8_t len)
+void nRF24_read(nrf24_t *dev, uint8_t* buf, uint8_t len)
 {
-	readPayload(buf, len);
+	readPayload(dev, buf, len);
 	
-	nRF24_writeRegister(NRF_STATUS, (1<<RX_DR) | (1<<MAX_RT) | (1<<TX_DS));	
+	nRF24_writeRegister(dev, NRF_STATUS, (1<<RX_DR) | (1<<MAX_RT) | (1<<TX_DS));	
 }
 
 /**
  * \brief write commando, starts the transmission
- * This function should be used for transmission
+ * Blocks until the payload is acknowledged or dropped, do not mix with nRF24_txQueue().
  * 
  * \param buf: pointer to the data buffer
  * \param len: length of the payload to be written
  *
  */
-bool nRF24_write(const void* buf, uint8_t len)
+bool nRF24_write(nrf24_t *dev, const void* buf, uint8_t len)
 {
-	return nRFwrite(buf, len, 0);
+	return nRFwrite(dev, buf, len, 0);
+}
+
+/**
+ * \brief write commando without ACK (W_TX_PAYLOAD_NO_ACK), blocks until the payload is sent
+ * Requires nRF24_enableDynamicAck(), do not mix with nRF24_txQueue().
+ * 
+ * \param buf: pointer to the data buffer
+ * \param len: length of the payload to be written
+ *
+ */
+bool nRF24_writeMulticast(nrf24_t *dev, const void* buf, uint8_t len)
+{
+	return nRFwrite(dev, buf, len, 1);
+}
+
+/**
+ * \brief XDMAC callback of the command list of a slot, start the transmission
+ */
+static void txPayloadWritten(void *arg)
+{
+	nrf24_t *dev = arg;
+	
+	dev->last_status = dev->tx_spi[0];
+	ioport_set_pin_level(dev->ce, 1);
+}
+
+/**
+ * \brief Queue a register write in the command list of a slot, skipped when the register shadow holds val
+ */
+static void txCmdRegister(nrf24_t *dev, spi_list_t *p_list, uint8_t reg, uint8_t val)
+{
+	uint8_t *p_cmd = dev->tx_cmd[p_list->count];
+	
+	reg &= REGISTER_MASK;
+	if (((SHADOW_REGS & dev->reg_shadow_valid) & (1UL << reg)) && (dev->reg_shadow[reg] == val))
+	{
+		return;
+	}
+	if (SHADOW_REGS & (1UL << reg))
+	{
+		dev->reg_shadow[reg] = val;
+		dev->reg_shadow_valid |= (1UL << reg);
+	}
+	p_cmd[0] = (W_REGISTER | reg);
+	p_cmd[1] = val;
+	spi_list_add(p_list, p_cmd, 2);
+}
+
+/**
+ * \brief Queue an address write (RX_ADDR_P0 or TX_ADDR) in the command list of a slot, skipped when unchanged
+ */
+static void txCmdAddress(nrf24_t *dev, spi_list_t *p_list, uint8_t reg, uint64_t address)
+{
+	uint8_t *p_cmd = dev->tx_cmd[p_list->count];
+	uint8_t idx = (reg == TX_ADDR) ? 1 : 0;
+	
+	if ((dev->addr_shadow_valid & (1 << idx)) && (dev->addr_shadow[idx] == address))
+	{
+		return;
+	}
+	dev->addr_shadow[idx] = address;
+	dev->addr_shadow_valid |= (1 << idx);
+	p_cmd[0] = (W_REGISTER | (REGISTER_MASK & reg));
+	memcpy(&p_cmd[1], &address, dev->addr_width);
+	spi_list_add(p_list, p_cmd, dev->addr_width + 1);
+}
+
+/**
+ * \brief Send the channel, the destination, the retries and the payload of a slot as one command list
+ * The XDMAC runs the transfers back to back and txPayloadWritten() raises CE after the last one,
+ * the CPU only fills the buffers.
+ */
+static void txWriteSlot(nrf24_t *dev, uint8_t slot)
+{
+	nrf24_tx_slot_t *p_slot = &dev->tx_slot[slot];
+	uint8_t size = dev->dynamic_payloads_enabled ? p_slot->len : dev->payload_size;
+	uint8_t len = (p_slot->len < size) ? p_slot->len : size;
+	spi_list_t list;
+	
+	spi_list_init(&list);
+	txCmdRegister(dev, &list, RF_CH, (p_slot->rf_ch == NRF24_TX_CH_HOME) ? dev->tx_channel : p_slot->rf_ch);
+	txCmdAddress(dev, &list, RX_ADDR_P0, p_slot->address);
+	txCmdAddress(dev, &list, TX_ADDR, p_slot->address);
+	txCmdRegister(dev, &list, RX_PW_P0, dev->payload_size);
+	if (p_slot->setup_retr)
+	{
+		txCmdRegister(dev, &list, SETUP_RETR, p_slot->setup_retr);
+	}
+	
+	dev->tx_spi[0] = p_slot->multicast ? W_TX_PAYLOAD_NO_ACK : W_TX_PAYLOAD;
+	memcpy(&dev->tx_spi[1], p_slot->payload, len);
+	memset(&dev->tx_spi[1 + len], 0, size - len);
+	spi_list_add(&list, dev->tx_spi, size + 1);
+	
+	while (!spi_master_transfer_list(dev->spi_cs, &list, txPayloadWritten, dev))
+	{
+		//the other radio is still clocking out its command list
+		spi_master_wait();
+	}
+}
+
+/**
+ * \brief Load the next pending slot and start its transmission
+ * Runs in the IRQ interrupt, or in the main context with the IRQ interrupt disabled.
+ */
+static void txStartNext(nrf24_t *dev)
+{
+	uint8_t i;
+	uint8_t slot;
+	
+	for (i = 0; i < NRF24_TX_SLOTS; i++)
+	{
+		slot = (dev->tx_next + i) % NRF24_TX_SLOTS;
+		if (dev->tx_pending & (1 << slot))
+		{
+			dev->tx_pending &= ~(1 << slot);
+			dev->tx_active = slot;
+			dev->tx_next = (slot + 1) % NRF24_TX_SLOTS;
+			
+			txWriteSlot(dev, slot);
+			return;
+		}
+	}
+	dev->tx_active = NRF24_TX_NONE;
+}
+
+/**
+ * \brief Finish the transmission in the air and start the next one
+ * Runs in the IRQ interrupt, or in the main context with the IRQ interrupt disabled.
+ */
+static void txService(nrf24_t *dev)
+{
+	uint8_t slot = dev->tx_active;
+	uint8_t status;
+	uint8_t retries;
+	uint8_t ack_len = 0;
+	
+	if (slot == NRF24_TX_NONE)
+	{
+		return;
+	}
+	
+	//clear the flags, the returned STATUS still holds them
+	status = nRF24_writeRegister(dev, NRF_STATUS, (1<<TX_DS) | (1<<MAX_RT));
+	if (!(status & ((1<<TX_DS) | (1<<MAX_RT))))
+	{
+		return;
+	}
+	ioport_set_pin_level(dev->ce, 0);
+	
+	//retransmissions needed for this payload
+	retries = (nRF24_readRegister(dev, OBSERVE_TX) >> ARC_CNT) & 0x0F;
+	
+	if (status & (1<<MAX_RT))
+	{
+		nRF24_FlushTx(dev);
+	}
+	else if (status & (1<<RX_DR))
+	{
+		//the receiver returned an ACK payload
+		ack_len = nRF24_getDynamicPayloadSize(dev);
+		if (ack_len)
+		{
+			readPayload(dev, dev->tx_ack_payload, ack_len);
+		}
+		nRF24_writeRegister(dev, NRF_STATUS, (1<<RX_DR));
+	}
+	if (dev->tx_callback)
+	{
+		dev->tx_callback(dev, slot, !(status & (1<<MAX_RT)), retries, dev->tx_ack_payload, ack_len);
+	}
+	txStartNext(dev);
+}
+
+/**
+ * \brief PIO interrupt handler of the IRQ pins, services the radios whose IRQ fired
+ */
+static void txIrqHandler(uint32_t id, uint32_t mask)
+{
+	uint8_t i;
+	
+	for (i = 0; i < irq_devices; i++)
+	{
+		if ((irq_device[i]->irq_pio_id == id) && (irq_device[i]->irq_mask & mask))
+		{
+			txService(irq_device[i]);
+		}
+	}
+}
+
+/**
+ * \brief mask the IRQ interrupts of all radios
+ * The radios share SPI0, the main context may not be interrupted by any of them while it talks to one.
+ */
+static void txLock(void)
+{
+	uint8_t i;
+	
+	for (i = 0; i < irq_devices; i++)
+	{
+		NVIC_DisableIRQ(irq_device[i]->irq_n);
+	}
+}
+
+/**
+ * \brief unmask the IRQ interrupts of all radios
+ */
+static void txUnlock(void)
+{
+	uint8_t i;
+	
+	for (i = 0; i < irq_devices; i++)
+	{
+		NVIC_EnableIRQ(irq_device[i]->irq_n);
+	}
+}
+
+/**
+ * \brief Start interrupt driven transmission
+ * The nRF24 must be configured as transmitter (nRF24_stopListening()).
+ * RX_DR is masked so the IRQ pin only reports TX_DS and MAX_RT.
+ * 
+ * \param dev radio, up to NRF24_MAX_DEVICES radios can use interrupt driven transmission
+ * \param callback called from the interrupt for every finished slot, can be NULL
+ *
+ */
+void nRF24_txInit(nrf24_t *dev, nrf24_tx_cb_t callback)
+{
+	uint8_t i;
+	
+	dev->tx_callback = callback;
+	dev->tx_pending = 0;
+	dev->tx_active = NRF24_TX_NONE;
+	dev->tx_channel = nRF24_getChannel(dev);
+	for (i = 0; i < NRF24_TX_SLOTS; i++)
+	{
+		dev->tx_slot[i].rf_ch = NRF24_TX_CH_HOME;
+	}
+	
+	for (i = 0; (i < irq_devices) && (irq_device[i] != dev); i++);
+	if (i == irq_devices)
+	{
+		if (irq_devices == NRF24_MAX_DEVICES)
+		{
+			return;
+		}
+		irq_device[irq_devices++] = dev;
+	}
+	
+	nRF24_writeRegister(dev, NRF_CONFIG, nRF24_readRegister(dev, NRF_CONFIG) | (1<<MASK_RX_DR));
+	nRF24_writeRegister(dev, NRF_STATUS, (1<<RX_DR) | (1<<TX_DS) | (1<<MAX_RT));
+	
+	pmc_enable_periph_clk(dev->irq_pio_id);
+	pio_set_input(dev->irq_pio, dev->irq_mask, PIO_PULLUP);
+	pio_handler_set(dev->irq_pio, dev->irq_pio_id, dev->irq_mask, PIO_IT_FALL_EDGE, txIrqHandler);
+	pio_handler_set_priority(dev->irq_pio, dev->irq_n, IRQ_PRIORITY);
+	pio_enable_interrupt(dev->irq_pio, dev->irq_mask);
+}
+
+/**
+ * \brief Queue a payload for transmission without waiting for it
+ * The payload is copied, a payload already waiting in the slot is replaced.
+ * 
+ * \param slot: destination slot (0 to NRF24_TX_SLOTS-1), reported back to the callback
+ * \param address: address of the receiving module
+ * \param buf: pointer to the data buffer
+ * \param len: length of the payload to be written
+ * \param multicast: send without ACK
+ *
+ * \return false if the slot is in the air or the parameters are invalid
+ */
+bool nRF24_txQueue(nrf24_t *dev, uint8_t slot, uint32_t address, const void* buf, uint8_t len, bool multicast)
+{
+	if (slot >= NRF24_TX_SLOTS || len > sizeof(dev->tx_slot[0].payload) || dev->tx_active == slot)
+	{
+		return 0;
+	}
+	
+	txLock();
+	dev->tx_slot[slot].address = address;
+	memcpy(dev->tx_slot[slot].payload, buf, len);
+	dev->tx_slot[slot].len = len;
+	dev->tx_slot[slot].multicast = multicast;
+	dev->tx_pending |= (1 << slot);
+	
+	if (dev->tx_active == NRF24_TX_NONE)
+	{
+		txStartNext(dev);
+	}
+	txUnlock();
+	
+	return 1;
+}
+
+/**
+ * \brief set the retransmission delay and count used for the payloads of a slot
+ * Applied when the next payload of the slot is loaded, the SETUP_RETR write is skipped when unchanged.
+ * 
+ * \param slot: destination slot (0 to NRF24_TX_SLOTS-1)
+ * \param delay: delay between retransmissions, 250us * (delay + 1)
+ * \param count: retransmissions before MAX_RT (1 to 15)
+ *
+ */
+void nRF24_txSetRetries(nrf24_t *dev, uint8_t slot, uint8_t delay, uint8_t count)
+{
+	if (slot < NRF24_TX_SLOTS)
+	{
+		dev->tx_slot[slot].setup_retr = (delay & 0xF) << ARD | (count & 0xF) << ARC;
+	}
+}
+
+/**
+ * \brief set the RF channel used for the payloads of a slot
+ * Applied when the next payload of the slot is loaded, the RF_CH write is skipped when unchanged.
+ * 
+ * \param slot: destination slot (0 to NRF24_TX_SLOTS-1)
+ * \param channel: RF channel (0 to 125), NRF24_TX_CH_HOME for the channel of nRF24_setChannel()
+ *
+ */
+void nRF24_txSetChannel(nrf24_t *dev, uint8_t slot, uint8_t channel)
+{
+	const uint8_t max_channel = 125;
+	if (slot < NRF24_TX_SLOTS)
+	{
+		dev->tx_slot[slot].rf_ch = (channel == NRF24_TX_CH_HOME || channel <= max_channel) ? channel : max_channel;
+	}
+}
+
+/**
+ * \brief checks if a slot still waits for or is in transmission
+ */
+bool nRF24_txBusy(nrf24_t *dev, uint8_t slot)
+{
+	return (dev->tx_active == slot) || (dev->tx_pending & (1 << slot));
+}
+
+/**
+ * \brief checks if all queued payloads are sent
+ */
+bool nRF24_txIdle(nrf24_t *dev)
+{
+	return (dev->tx_active == NRF24_TX_NONE) && !dev->tx_pending;
+}
+
+/**
+ * \brief Recover from a missed IRQ edge
+ * Call regularly from the main context, finishes a transmission whose IRQ is asserted but was not handled.
+ */
+void nRF24_txPoll(nrf24_t *dev)
+{
+	if ((dev->tx_active != NRF24_TX_NONE) && !(pio_get(dev->irq_pio, PIO_INPUT, dev->irq_mask)))
+	{
+		txLock();
+		txService(dev);
+		txUnlock();
+	}
 }
\ No newline at end of file
@@ -11,7 +11,86 @@
 
 #include "nRF24L01.h"
 
-#define CE PIO_PC9_IDX
+/* Radios that can be driven at the same time, every radio has its own nrf24_t */
+#define NRF24_MAX_DEVICES 2
+
+/* Interrupt priority of the IRQ pins (active low) */
+#define IRQ_PRIORITY    3
+
+/* SPI calibration: write/readback rounds per setting */
+#define SPI_CAL_ROUNDS  4
+
+/* Channel survey */
+#define NRF24_CHANNELS  126
+#define RPD_SETTLE_US   170 //RX settling (130us) + RPD detection (40us)
+
+/* Interrupt driven transmission: one payload can be queued per slot (destination) */
+#define NRF24_TX_SLOTS  9
+#define NRF24_TX_NONE   0xFF
+#define NRF24_TX_CH_HOME 0xFF //slot sent on the channel of nRF24_setChannel()
+#define NRF24_TX_CMDS   5 //RF_CH, RX_ADDR_P0, TX_ADDR, RX_PW_P0, SETUP_RETR
+
+/* SPI transfer buffer: a command with a 32 byte payload, padded to whole data cache lines */
+#define NRF24_SPI_BUF   64
+
+/* Called from the IRQ interrupt when the payload of a slot was acknowledged (ack) or dropped after the retries.
+   retries is the number of retransmissions (ARC_CNT of OBSERVE_TX).
+   ack_payload holds ack_len bytes returned by the receiver (EN_ACK_PAY), only valid during the call. */
+struct nrf24_device;
+typedef void (*nrf24_tx_cb_t)(struct nrf24_device *dev, uint8_t slot, bool ack, uint8_t retries, const uint8_t *ack_payload, uint8_t ack_len);
+
+/* Interrupt driven transmission.
+   The main context fills a slot and sets its bit in tx_pending, the IRQ interrupt sends
+   the pending slots one by one (round robin) and reports the result through tx_callback. */
+typedef struct {
+	uint32_t address;
+	uint8_t payload[32];
+	uint8_t len;
+	bool multicast;
+	uint8_t setup_retr; // SETUP_RETR used for this slot, 0 keeps the current setting
+	uint8_t rf_ch; // RF_CH used for this slot, NRF24_TX_CH_HOME uses tx_channel
+} nrf24_tx_slot_t;
+
+/* One nRF24 radio: its pins and the state the library keeps for it.
+   Only the pins are filled in by the application (NRF24_DEVICE), nRF24_begin sets up the rest. */
+typedef struct nrf24_device {
+	uint8_t spi_cs; // SPI0 chip select (NPCSx)
+	uint32_t ce; // CE pin (ioport index)
+	Pio *irq_pio; // IRQ pin
+	uint32_t irq_pio_id;
+	IRQn_Type irq_n;
+	uint32_t irq_mask;
+	
+	uint32_t txDelay; // delay tussen TX paketten
+	uint8_t payload_size; // grootte van de payload
+	uint8_t addr_width; // adres lengte
+	bool dynamic_payloads_enabled;
+	uint8_t pipe0_reading_address[5]; // dummy locatie voor Pipe0 adres
+	
+	uint8_t reg_shadow[FEATURE + 1];
+	uint32_t reg_shadow_valid; // bit n set when reg_shadow[n] holds register n
+	uint64_t addr_shadow[2]; // [0] RX_ADDR_P0, [1] TX_ADDR
+	uint8_t addr_shadow_valid; // bit n set when addr_shadow[n] holds the address
+	uint8_t last_status; // STATUS returned by the last SPI transfer
+	
+	nrf24_tx_slot_t tx_slot[NRF24_TX_SLOTS];
+	volatile uint16_t tx_pending; // bit n set when tx_slot[n] waits to be sent
+	volatile uint8_t tx_active; // slot in the air
+	uint8_t tx_next; // first slot checked for the next transmission
+	uint8_t tx_channel; // RF_CH of the slots without a channel of their own (nRF24_setChannel)
+	nrf24_tx_cb_t tx_callback;
+	uint8_t tx_ack_payload[32]; // ACK payload returned with the last acknowledged slot
+	
+	/* command list of the slot in the air, read by the XDMAC: every buffer starts on its own cache line
+	   and is padded to whole lines (last members, the struct is rounded up to the alignment) */
+	COMPILER_ALIGNED(32) uint8_t tx_cmd[NRF24_TX_CMDS][8]; // register writes sent in front of the payload (W_REGISTER + up to 5 bytes)
+	COMPILER_ALIGNED(32) uint8_t tx_spi[NRF24_SPI_BUF]; // W_TX_PAYLOAD
+} nrf24_t;
+
+/* Initializer of the pins of a radio: chip select, CE pin and the PIO/pin of IRQ */
+#define NRF24_DEVICE(cs, ce_pin, pio, pin) { \
+	.spi_cs = (cs), .ce = (ce_pin), \
+	.irq_pio = PIO##pio, .irq_pio_id = ID_PIO##pio, .irq_n = PIO##pio##_IRQn, .irq_mask = (pin) }
 
 /*data enumeration*/
 typedef enum{
@@ -79,46 +158,66 @@ static const char * const rf24_pa_dbm_e_str_P[] = {
 };
 
 //public functions
-uint8_t nRF24_readRegister(uint8_t reg);
-uint8_t nRF24_writeRegister(uint8_t reg, uint8_t val);
-uint8_t nRF24_FlushRx(void);
-uint8_t nRF24_FlushTx(void);
-uint8_t nRF24_getStatus(void);
-bool nRF24_setDataRate(rf24_datarate_e speed);
-rf24_datarate_e getDataRate(void);
-void nRF24_setCRCLength(rf24_crclength_e length);
-rf24_crclength_e getCRCLength(void);
-void nRF24_setPALevel(uint8_t level);
-uint8_t nRF24_getPALevel(void);
-void printDetails(void);
-void nRF24_closeReadingPipe(uint8_t pipe);
-void nRF24_setAddressWidth(uint8_t width);
-void nRF24_setRetries(uint8_t delay, uint8_t count);
-void toggle_features(void);
-void nRF24_setChannel(uint8_t channel);
-void nRF24_powerUp(void);
-void nRF24_powerDown(void);
-void nRF24_startListening(void);
-void nRF24_stopListening(void);
-bool nRF24_begin(void);
-void nRF24_openWritingPipe(uint64_t address);
-void nRF24_setPayloadSize(uint8_t size);
-uint8_t nRF24_getpayloadSize(void);
-void nRF24_openReadingPipe(uint8_t pipe, uint64_t address);
-bool nRF24_available(uint8_t* pipe_num);
-void nRF24_read(uint8_t* buf, uint8_t len);
-bool nRF24_write(const void* buf, uint8_t len);
+uint8_t nRF24_readRegister(nrf24_t *dev, uint8_t reg);
+uint8_t nRF24_writeRegister(nrf24_t *dev, uint8_t reg, uint8_t val);
+void nRF24_invalidateShadow(nrf24_t *dev);
+uint8_t nRF24_FlushRx(nrf24_t *dev);
+uint8_t nRF24_FlushTx(nrf24_t *dev);
+uint8_t nRF24_getStatus(nrf24_t *dev);
+bool nRF24_setDataRate(nrf24_t *dev, rf24_datarate_e speed);
+rf24_datarate_e getDataRate(nrf24_t *dev);
+void nRF24_setCRCLength(nrf24_t *dev, rf24_crclength_e length);
+rf24_crclength_e getCRCLength(nrf24_t *dev);
+void nRF24_setPALevel(nrf24_t *dev, uint8_t level);
+uint8_t nRF24_getPALevel(nrf24_t *dev);
+void printDetails(nrf24_t *dev);
+void nRF24_closeReadingPipe(nrf24_t *dev, uint8_t pipe);
+void nRF24_setAddressWidth(nrf24_t *dev, uint8_t width);
+void nRF24_setRetries(nrf24_t *dev, uint8_t delay, uint8_t count);
+void toggle_features(nrf24_t *dev);
+void nRF24_setChannel(nrf24_t *dev, uint8_t channel);
+uint8_t nRF24_getChannel(nrf24_t *dev);
+uint8_t nRF24_pickChannel(const uint8_t* histogram, const uint8_t* avoid, uint8_t avoid_count, uint8_t spacing);
+uint8_t nRF24_surveyChannels(nrf24_t *dev, uint8_t* histogram, uint8_t sweeps);
+void nRF24_powerUp(nrf24_t *dev);
+void nRF24_powerDown(nrf24_t *dev);
+void nRF24_startListening(nrf24_t *dev);
+void nRF24_stopListening(nrf24_t *dev);
+void nRF24_enableDynamicAck(nrf24_t *dev);
+void nRF24_enableDynamicPayloads(nrf24_t *dev);
+void nRF24_disableDynamicPayloads(nrf24_t *dev);
+uint8_t nRF24_getDynamicPayloadSize(nrf24_t *dev);
+void nRF24_enableAckPayload(nrf24_t *dev);
+bool nRF24_begin(nrf24_t *dev);
+uint32_t nRF24_calibrateSpi(nrf24_t *dev);
+void nRF24_openWritingPipe(nrf24_t *dev, uint64_t address);
+void nRF24_setPayloadSize(nrf24_t *dev, uint8_t size);
+uint8_t nRF24_getpayloadSize(nrf24_t *dev);
+void nRF24_openReadingPipe(nrf24_t *dev, uint8_t pipe, uint64_t address);
+bool nRF24_available(nrf24_t *dev, uint8_t* pipe_num);
+void nRF24_read(nrf24_t *dev, uint8_t* buf, uint8_t len);
+bool nRF24_write(nrf24_t *dev, const void* buf, uint8_t len);
+bool nRF24_writeMulticast(nrf24_t *dev, const void* buf, uint8_t len);
+void nRF24_txInit(nrf24_t *dev, nrf24_tx_cb_t callback);
+bool nRF24_txQueue(nrf24_t *dev, uint8_t slot, uint32_t address, const void* buf, uint8_t len, bool multicast);
+void nRF24_txSetRetries(nrf24_t *dev, uint8_t slot, uint8_t delay, uint8_t count);
+void nRF24_txSetChannel(nrf24_t *dev, uint8_t slot, uint8_t channel);
+bool nRF24_txBusy(nrf24_t *dev, uint8_t slot);
+bool nRF24_txIdle(nrf24_t *dev);
+void nRF24_txPoll(nrf24_t *dev);
 
 /*//private functions
-static void startFastWrite(const void* buf, uint8_t len, const bool multicast);
-static uint8_t read_register(uint8_t reg, uint8_t* buf, uint8_t len);
-static uint8_t writeRegister(uint8_t reg, const uint8_t* buf, uint8_t length);
+static void startFastWrite(nrf24_t *dev, const void* buf, uint8_t len, const bool multicast);
+static uint8_t read_register(nrf24_t *dev, uint8_t reg, uint8_t* buf, uint8_t len);
+static uint8_t readRegisterDirect(nrf24_t *dev, uint8_t reg);
+static uint8_t writeRegister(nrf24_t *dev, uint8_t reg, const uint8_t* buf, uint8_t length);
+static void writeAddress(nrf24_t *dev, uint8_t reg, uint64_t address);
 static bool isPVariant(void);
 static void print_status (uint8_t status);
-static void print_address_register(const char* name, uint8_t reg, uint8_t qty);
-static void print_byte_register(const char* name, uint8_t reg, uint8_t qty);
-static uint8_t writePayload(const void* buf, uint8_t data_len, const uint8_t writeType);
-static bool nRFwrite(const void* buf, uint8_t len, const bool multicast);
-static uint8_t readPayload(uint8_t* buf, uint8_t data_len);
+static void print_address_register(nrf24_t *dev, const char* name, uint8_t reg, uint8_t qty);
+static void print_byte_register(nrf24_t *dev, const char* name, uint8_t reg, uint8_t qty);
+static uint8_t writePayload(nrf24_t *dev, const void* buf, uint8_t data_len, const uint8_t writeType);
+static bool nRFwrite(nrf24_t *dev, const void* buf, uint8_t len, const bool multicast);
+static uint8_t readPayload(nrf24_t *dev, uint8_t* buf, uint8_t data_len);
 */
 #endif /* NRF24_H_ */
\ No newline at end of file
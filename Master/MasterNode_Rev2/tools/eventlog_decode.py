@@ -0,0 +1,84 @@
+#!/usr/bin/env python3
+"""Decode the binary event log of the masterNode (src/softLib/eventLog.h).
+
+Reads the console USART capture from a file or stdin and prints one line per record:
+    python3 eventlog_decode.py capture.bin
+    python3 eventlog_decode.py --port /dev/ttyUSB0 --baud 115200   (needs pyserial)
+The event table is parsed from eventLog.h, so the decoder follows the firmware it is built with.
+Boot messages (plain text before the log starts) are passed through.
+"""
+
+import argparse
+import os
+import re
+import struct
+import sys
+
+HEADER = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                      '..', 'MasterNode_Rev2', 'src', 'softLib', 'eventLog.h')
+RECORD = struct.Struct('<BB6sI')  # sync, id, arg[6], stamp
+
+
+def load_events(path):
+    text = open(path).read()
+    sync = int(re.search(r'#define EVENTLOG_SYNC\s+(0x[0-9A-Fa-f]+|\d+)', text).group(1), 0)
+    table = re.findall(r'X\((EV_\w+),\s*"([^"]*)",\s*"([^"]*)"\)', text)
+    # id 0 is EV_NONE, the table starts at 1
+    events = {n + 1: (name, '<' + args, fmt) for n, (name, args, fmt) in enumerate(table)}
+    return sync, events
+
+
+def decode(stream, sync, events, cpu_hz):
+    buf = b''
+    last = None
+    while True:
+        chunk = stream.read(256)
+        if not chunk:
+            break
+        buf += chunk
+        while len(buf) >= RECORD.size:
+            if buf[0] != sync or buf[1] not in events:
+                # text from the boot printf or a resync after a lost byte
+                end = buf.find(bytes([sync]), 1)
+                end = len(buf) if end < 0 else end
+                sys.stdout.write(buf[:end].decode('ascii', 'replace'))
+                buf = buf[end:]
+                continue
+            _, ev, args, stamp = RECORD.unpack_from(buf)
+            buf = buf[RECORD.size:]
+            name, layout, fmt = events[ev]
+            values = struct.unpack_from(layout, args)
+            delta = '' if last is None else ' (+%.1f us)' % (((stamp - last) & 0xFFFFFFFF) * 1e6 / cpu_hz)
+            last = stamp
+            try:
+                line = fmt % values
+            except (TypeError, ValueError):
+                line = '%s %r' % (name, values)
+            print('%10u%s %s' % (stamp, delta, line))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('capture', nargs='?', help='capture file, stdin when omitted')
+    parser.add_argument('--port', help='serial port to read from')
+    parser.add_argument('--baud', type=int, default=115200)
+    parser.add_argument('--cpu-hz', type=float, default=300e6, help='DWT cycle counter clock')
+    parser.add_argument('--header', default=HEADER, help='eventLog.h with the event table')
+    opts = parser.parse_args()
+
+    sync, events = load_events(opts.header)
+    if opts.port:
+        import serial
+        stream = serial.Serial(opts.port, opts.baud)
+    elif opts.capture:
+        stream = open(opts.capture, 'rb')
+    else:
+        stream = sys.stdin.buffer
+    try:
+        decode(stream, sync, events, opts.cpu_hz)
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,24 @@
+/*
+ * conf_profile.h
+ *
+ * Created: 17/10/2026 20:24:52
+ *  Author: Design
+ */
+
+#ifndef CONF_PROFILE_H_INCLUDED
+#define CONF_PROFILE_H_INCLUDED
+
+#include "stm32f7xx_hal.h"
+
+/* Build the cycle counter probes (Master/libraries/profile), the table is printed over SWO
+   every PROFILE_DUMP_MS. Comment out to compile the probes away. */
+#define PROFILE_ENABLE
+#define PROFILE_DUMP_MS         5000
+
+#define PROFILE_CPU_HZ()        SystemCoreClock
+
+/* Probes, all in the main loop. The master pipeline probes of the SAM E70 project follow with the Art-Net port. */
+#define PROFILE_PROBES(X) \
+  X(PROF_LOOP,        "loop")       /* one main loop pass, MX_TouchGFX_Process() */
+
+#endif /* CONF_PROFILE_H_INCLUDED */
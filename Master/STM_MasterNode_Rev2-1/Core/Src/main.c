@@ -24,7 +24,8 @@
 
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
-
+#include <stdio.h>
+#include "profile.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -54,7 +55,10 @@ DMA_HandleTypeDef hdma_spi2_tx;
 DMA_HandleTypeDef hdma_spi2_rx;
 
 /* USER CODE BEGIN PV */
-
+#ifdef PROFILE_ENABLE
+static char profileText[512];
+static uint32_t profileDumpTick;
+#endif
 /* USER CODE END PV */
 
 /* Private function prototypes -----------------------------------------------*/
@@ -116,7 +120,11 @@ int main(void)
   MX_CRC_Init();
   MX_TouchGFX_Init();
   /* USER CODE BEGIN 2 */
-
+#ifdef PROFILE_ENABLE
+  profile_initialize();
+  profileDumpTick = HAL_GetTick();
+#endif
+  PROFILE_BEGIN(PROF_LOOP);
   /* USER CODE END 2 */
 
   /* Infinite loop */
@@ -127,6 +135,18 @@ int main(void)
 
   MX_TouchGFX_Process();
     /* USER CODE BEGIN 3 */
+    PROFILE_END(PROF_LOOP);
+#ifdef PROFILE_ENABLE
+    if ((HAL_GetTick() - profileDumpTick) >= PROFILE_DUMP_MS)
+    {
+      profileDumpTick = HAL_GetTick();
+      profile_report(profileText, sizeof(profileText), 0);
+      printf("%s", profileText);
+      profile_report(profileText, sizeof(profileText), 1);
+      printf("%s\n", profileText);
+    }
+#endif
+    PROFILE_BEGIN(PROF_LOOP);
   }
   /* USER CODE END 3 */
 }
@@ -421,7 +441,16 @@ static void MX_GPIO_Init(void)
 }
 
 /* USER CODE BEGIN 4 */
-
+/**
+  * @brief  printf() output on the SWO pin (ITM stimulus port 0), read it with the SWV console of the debugger.
+  * @param  ch character to send
+  * @retval the character
+  */
+int __io_putchar(int ch)
+{
+  ITM_SendChar((uint32_t)ch);
+  return ch;
+}
 /* USER CODE END 4 */
 
 /**
@@ -0,0 +1,156 @@
+/*
+ * profile.c
+ *
+ * Created: 17/10/2026 20:05:14
+ *  Author: Design
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "profile.h"
+
+#ifdef PROFILE_ENABLE
+
+profile_probe_t profile_probes[PROFILE_COUNT];
+
+#define PROFILE_NAME(id, name)	name,
+static const char *const gs_names[PROFILE_COUNT] = {
+	PROFILE_PROBES(PROFILE_NAME)
+};
+
+/* Cycles of an empty BEGIN/END pair, taken off every sample */
+static uint32_t gs_ul_overhead;
+
+/**
+ * \brief Start the DWT cycle counter, measure the probe overhead and clear all probes.
+ * The overhead is the fastest of PROFILE_CAL_ROUNDS empty PROFILE_BEGIN()/PROFILE_END() pairs on the first
+ * probe, so it holds the same store, load and call as a real sample.
+ */
+void profile_initialize(void)
+{
+	uint8_t n;
+
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->LAR = 0xC5ACCE55; //unlock the DWT on the Cortex-M7
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+	gs_ul_overhead = 0;
+	profile_reset();
+	for (n = 0; n < PROFILE_CAL_ROUNDS; n++) {
+		PROFILE_BEGIN(0);
+		PROFILE_END(0);
+	}
+	gs_ul_overhead = profile_probes[0].min;
+	profile_reset();
+}
+
+/**
+ * \brief Add a sample to a probe, called by PROFILE_END().
+ *
+ * \param id Probe (enum profile_id).
+ * \param cycles Cycles between PROFILE_BEGIN() and PROFILE_END().
+ */
+void profile_record(uint8_t id, uint32_t cycles)
+{
+	profile_probe_t *p_probe = &profile_probes[id];
+	uint32_t bin;
+
+	cycles = (cycles > gs_ul_overhead) ? cycles - gs_ul_overhead : 0;
+	bin = cycles ? 32 - __CLZ(cycles) : 0;
+	if (bin >= PROFILE_BINS) {
+		bin = PROFILE_BINS - 1;
+	}
+	p_probe->bin[bin]++;
+	if (cycles < p_probe->min) {
+		p_probe->min = cycles;
+	}
+	if (cycles > p_probe->max) {
+		p_probe->max = cycles;
+	}
+	p_probe->total += cycles;
+	p_probe->count++;
+}
+
+/**
+ * \brief Clear all probes.
+ */
+void profile_reset(void)
+{
+	uint32_t primask = __get_PRIMASK();
+	uint8_t n;
+
+	__disable_irq();
+	memset(profile_probes, 0, sizeof(profile_probes));
+	for (n = 0; n < PROFILE_COUNT; n++) {
+		profile_probes[n].min = UINT32_MAX;
+	}
+	__set_PRIMASK(primask);
+}
+
+/**
+ * \brief Print the probe table as text, one line per probe.
+ * Without b_histogram: count, min, average and max in cycles and the average in us.
+ * With b_histogram: the non-empty log2 bins as "bit:count", bit n holds the spans below 2^n cycles.
+ * Lines that do not fit in p_text are left out.
+ *
+ * \param p_text Output buffer.
+ * \param size Size of p_text.
+ * \param b_histogram Print the histograms instead of the summary.
+ *
+ * \return Length of the text without the terminating zero.
+ */
+uint16_t profile_report(char *p_text, uint16_t size, uint8_t b_histogram)
+{
+	uint32_t cycles_per_us = PROFILE_CPU_HZ() / 1000000;
+	profile_probe_t probe;
+	uint32_t primask;
+	uint32_t avg;
+	uint16_t len = 0;
+	uint16_t line;
+	int written;
+	uint8_t n, bin;
+
+	p_text[0] = '\0';
+	for (n = 0; n < PROFILE_COUNT; n++) {
+		//snapshot, the probes in the interrupts keep recording
+		primask = __get_PRIMASK();
+		__disable_irq();
+		probe = profile_probes[n];
+		__set_PRIMASK(primask);
+
+		line = len;
+		if (probe.count == 0) {
+			written = snprintf(&p_text[len], size - len, "%-10s no samples\n", gs_names[n]);
+		}
+		else if (!b_histogram) {
+			avg = (uint32_t)(probe.total / probe.count);
+			written = snprintf(&p_text[len], size - len, "%-10s n=%lu min=%lu avg=%lu max=%lu cyc, avg %lu.%02lu us\n",
+				gs_names[n], (unsigned long)probe.count, (unsigned long)probe.min, (unsigned long)avg,
+				(unsigned long)probe.max, (unsigned long)(avg / cycles_per_us),
+				(unsigned long)(((avg % cycles_per_us) * 100) / cycles_per_us));
+		}
+		else {
+			written = snprintf(&p_text[len], size - len, "%-10s", gs_names[n]);
+			for (bin = 0; (written >= 0) && (written < (size - len)) && (bin < PROFILE_BINS); bin++) {
+				if (probe.bin[bin]) {
+					len += written;
+					written = snprintf(&p_text[len], size - len, " %u:%lu", bin, (unsigned long)probe.bin[bin]);
+				}
+			}
+			if ((written >= 0) && (written < (size - len))) {
+				len += written;
+				written = snprintf(&p_text[len], size - len, "\n");
+			}
+		}
+		if ((written < 0) || (written >= (size - len))) {
+			//drop the partial line
+			len = line;
+			p_text[len] = '\0';
+			break;
+		}
+		len += written;
+	}
+	return len;
+}
+
+#endif /* PROFILE_ENABLE */
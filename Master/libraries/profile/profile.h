@@ -0,0 +1,72 @@
+/*
+ * profile.h
+ *
+ * Cycle counter profiling probes, shared by the masterNode (ASF project, SAM E70) and the STM32F7 port.
+ * Both projects add this folder to their include paths and build profile.c with the project.
+ *
+ * A probe measures the cycles between PROFILE_BEGIN(id) and PROFILE_END(id) with the DWT cycle counter
+ * of the Cortex-M7 and keeps count, total, min, max and a log2 histogram: bin n counts the spans of
+ * 2^(n-1) up to 2^n - 1 cycles, bin 0 the empty spans.
+ * Every project supplies conf_profile.h with
+ *   the CMSIS device header (DWT, CoreDebug, __CLZ),
+ *   PROFILE_ENABLE       define to build the probes, without it the macros compile to nothing,
+ *   PROFILE_CPU_HZ()     core clock in Hz,
+ *   PROFILE_PROBES(X)    probe table, X(id, name) per probe.
+ *
+ * A probe is not reentrant: every id is used from one context (main loop or one interrupt) and its
+ * BEGIN and END pairs do not nest with themselves.
+ */
+
+
+#ifndef PROFILE_H_
+#define PROFILE_H_
+
+#include <stdint.h>
+#include "conf_profile.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PROFILE_BINS            32
+#define PROFILE_CAL_ROUNDS      8 //empty BEGIN/END pairs measured by profile_initialize(), the fastest one counts
+
+#define PROFILE_ENUM(id, name)	id,
+enum profile_id {
+	PROFILE_PROBES(PROFILE_ENUM)
+	PROFILE_COUNT
+};
+
+typedef struct profile_probe {
+	uint32_t start; //cycle counter at PROFILE_BEGIN()
+	uint32_t count;
+	uint64_t total;
+	uint32_t min;
+	uint32_t max;
+	uint32_t bin[PROFILE_BINS];
+} profile_probe_t;
+
+#ifdef PROFILE_ENABLE
+
+extern profile_probe_t profile_probes[PROFILE_COUNT];
+
+#define PROFILE_BEGIN(id)       do { profile_probes[id].start = DWT->CYCCNT; } while (0)
+#define PROFILE_END(id)         profile_record((id), DWT->CYCCNT - profile_probes[id].start)
+
+void profile_initialize(void);
+void profile_record(uint8_t id, uint32_t cycles);
+void profile_reset(void);
+uint16_t profile_report(char *p_text, uint16_t size, uint8_t b_histogram);
+
+#else
+
+#define PROFILE_BEGIN(id)       do { } while (0)
+#define PROFILE_END(id)         do { } while (0)
+
+#endif /* PROFILE_ENABLE */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PROFILE_H_ */
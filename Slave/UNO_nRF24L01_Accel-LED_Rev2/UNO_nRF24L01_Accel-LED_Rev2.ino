@@ -46,47 +46,48 @@
 #include <RoboCore_MMA8452Q.h>
 #include <FastLED.h>
 #include <hsv2rgb.h>
+#include <radioFrame.h>
 
 #ifdef DEBUG
 #include <printf.h>
 #endif
 
-/*Command enumeration*/
-typedef enum sensorCommand : uint8_t{
-  disabled = 0,
-  active_hue,
-  active_sat,
-  active_int, 
-  receive_hue,
-  receive_sat,
-  receive_int,
-  reset
-}e_command;
-
-/* Datapaket standaard.
-   datapaketten verzonden binnen dit project zullen dit formaat hanteren om een uniform systeem te vormen
-   srcNode    //Enumeration van de node waar de data van origineerd
-   destNode   //Enumeration van de node waar deze data voor bestemd is.
-   command      //commando (Enum) gestuctureerd volgens command table
-   intensity    //intensity of the LEDs
-   hue          //color of the LEDs transcoded in a hue
-   saturation   //saturation of the colors
-   sensorval    //sensor values to use in calculations sigend (8-bit, value tussen -128 tot 127)
+/* Radio frames.
+   datapaketten verzonden binnen dit project hanteren de frames van radioFrame.h (Slave/libraries/radioFrame),
+   hetzelfde bestand wordt door de masterNode gebruikt: vaste byte offsets en een versie/type header byte.
+   dataStruct       commando voor een node (van de masterNode of van een andere node)
+   broadcastStruct  commando en HSI van meerdere nodes, zonder ACK verzonden naar broadcastPipe.
+                    Elke node haalt er enkel zijn eigen slice uit (node = localAddr).
+   sensorStruct     sensor uplink naar de masterNode, vooraf geladen als ACK payload,
+                    het volgende commando van de masterNode neemt ze mee terug.
+   channelStruct    kanaal aankondiging van de masterNode op RF_RENDEZVOUS_CHANNEL (broadcastPipe),
+                    node n (localAddr - 1) luistert naar channel[n / nodesPerRadio].
+   Zonder data van de masterNode gedurende RF_LOST_MS keert de node terug naar het rendezvous kanaal.
 */
-struct dataStruct {
-  byte srcNode;
-  byte destNode;
-  e_command senCommand;
-  uint8_t intensity;
-  uint8_t hue;
-  uint8_t saturation;
-  int8_t sensorVal;
-} dataIn, dataOut;
+#define BROADCAST_PIPE 4
+#define RF_RENDEZVOUS_CHANNEL 76
+#define RF_LOST_MS 3000
+dataStruct dataIn, dataOut = {RF_FRAME_HEADER(RF_FRAME_DATA)};
+broadcastStruct broadcastIn;
+sensorStruct ackOut = {RF_FRAME_HEADER(RF_FRAME_SENSOR), 0, 0, 0, RF_TRACE_NONE, 0, RF_SHOW_NONE};
+channelStruct channelIn;
+uint8_t rfChannel = RF_RENDEZVOUS_CHANNEL;
+unsigned long lastRxMillis;
+
+/* Latency trace.
+   Van het laatst ontvangen traced frame (seq != RF_TRACE_NONE) wordt de ontvangsttijd bewaard,
+   na FastLED.show() gaat de tijd tot het einde van show() met seq en stamp terug in de ACK payload.
+*/
+uint8_t traceSeq;
+uint16_t traceStamp;
+unsigned long traceRxMicros;
+bool tracePending;
 
 /*Variables for the nRF module*/
 RF24 radio(9, 10, 5000000); //CE, CSN
 const byte localAddr = 1;
 const uint32_t listeningPipes[5] = {0x3A3A3AA1UL, 0x3A3A3AB1UL, 0x3A3A3AC1UL, 0x3A3A3AD1UL, 0x3A3A3AE1UL};
+const uint32_t broadcastPipe = 0x3A3A3A00UL; //zelfde hoogste bytes als listeningPipes (pipe 1)
 bool b_tx_ok, b_tx_fail, b_rx_ready = 0;
 
 /*Variables for the MMA module*/
@@ -124,8 +125,12 @@ void setup() {
     Serial.println("radio initialised");
   
   radio.setAddressWidth(4);
+  radio.enableDynamicPayloads(); //payloads are not padded to 32 bytes, the masterNode does the same
+  radio.enableAckPayload(); //sensor uplink in the ACK packets
+  radio.setChannel(rfChannel); //wacht op de kanaal aankondiging van de masterNode
   for (uint8_t i = 0; i < 4; i++)
     radio.openReadingPipe(i, listeningPipes[localAddr] + i);
+  radio.openReadingPipe(BROADCAST_PIPE, broadcastPipe);
 
   radio.setPALevel(RF24_PA_HIGH);
 
@@ -144,12 +149,15 @@ void setup() {
     Serial.println("accel active");
   
   radio.startListening();
+  preloadAck();
 }
 
 void loop() {
   uint8_t calcSensorVal;
   float inBetween = 0;
 
+  radioWatchdog();
+
 #ifdef INTERRUPT  
   /* Uitvoering op interrupt basis
   * commando wordt opgeslagen
@@ -159,7 +167,8 @@ void loop() {
   #ifdef CONTINIOUS //Interrupt continious
     if(b_rx_ready){
       b_rx_ready = 0;
-      radio.read(&dataIn, sizeof(dataIn));
+      if (radioRead())
+        preloadAck();
       #ifdef DEBUG
           Serial.println("IRQ geweest");
           printf("srcNode: %d\n\r", dataIn.srcNode);
@@ -236,7 +245,7 @@ void loop() {
       }// end switch
       
       //noInterrupts();
-      FastLED.show();
+      showLeds();
       //interrupts();
       /* delay om uitvoering te vertragen tot 40Hz
       * uitvoering wordt vertraagd met 25 ms 
@@ -265,6 +274,7 @@ void loop() {
             printf("\n\rdata send: %d\n\r", dataOut.saturation);
           #endif
           radio.startListening();
+          preloadAck(); //startListening() flushed the ACK payload
 
           fill_solid(leds, NUM_LEDS, CHSV(deskHue, deskSat, deskInt));
           
@@ -284,6 +294,7 @@ void loop() {
             printf("\n\rdata send: %d\n\r", dataOut.saturation);
           #endif
           radio.startListening();
+          preloadAck(); //startListening() flushed the ACK payload
 
           fill_solid(leds, NUM_LEDS, CHSV(deskHue, deskSat, deskInt));
           break;
@@ -302,6 +313,7 @@ void loop() {
             printf("\n\rdata send: %d\n\r", dataOut.saturation);
           #endif
           radio.startListening();
+          preloadAck(); //startListening() flushed the ACK payload
 
           fill_solid(leds, NUM_LEDS, CHSV(deskHue, deskSat, deskInt));
           break;
@@ -348,7 +360,7 @@ void loop() {
       #endif
 
         //noInterrupts();
-        FastLED.show();
+        showLeds();
         //interrupts();
       /* delay om uitvoering te vertragen tot 40Hz
       * uitvoering wordt vertraagd met 25 ms 
@@ -365,7 +377,8 @@ void loop() {
   #ifndef CONTINIOUS //Interrupt Single operation
     if(b_rx_ready){
       b_rx_ready = 0;
-      radio.read(&dataIn, sizeof(dataIn));
+      if (radioRead())
+        preloadAck();
       #ifdef DEBUG
           Serial.println("IRQ geweest");
           printf("srcNode: %d\n\r", dataIn.srcNode);
@@ -446,7 +459,7 @@ void loop() {
     #ifdef DEBUG
       printf("Display LED\n\r");
     #endif
-          FastLED.show();
+          showLeds();
           
         }// end if
         if(dataIn.destNode != localAddr){ //data comes from or is destined to other node
@@ -466,6 +479,7 @@ void loop() {
       printf("\n\rdata send: %d\n\r", dataOut.saturation);
     #endif
             radio.startListening();
+            preloadAck(); //startListening() flushed the ACK payload
 
             fill_solid(leds, NUM_LEDS, CHSV(deskHue, deskSat, deskInt));
           
@@ -485,6 +499,7 @@ void loop() {
       printf("\n\rdata send: %d\n\r", dataOut.saturation);
     #endif
             radio.startListening();
+            preloadAck(); //startListening() flushed the ACK payload
 
             fill_solid(leds, NUM_LEDS, CHSV(deskHue, deskSat, deskInt));
             break;
@@ -503,6 +518,7 @@ void loop() {
       printf("\n\rdata send: %d\n\r", dataOut.saturation);
     #endif
             radio.startListening();
+            preloadAck(); //startListening() flushed the ACK payload
 
             fill_solid(leds, NUM_LEDS, CHSV(deskHue, deskSat, deskInt));
             break;
@@ -547,7 +563,7 @@ void loop() {
       printf("Display LED\n\r");
     #endif
 
-          FastLED.show();
+          showLeds();
       /* delay om uitvoering te vertragen tot 40Hz
       * uitvoering wordt vertraagd met 25 ms 
       * We gaan er van uit dat al de rest "instant" wordt uitgevoerd. 
@@ -568,7 +584,8 @@ void loop() {
   radio.whatHappened(b_tx_ok, b_tx_fail, b_rx_ready);
   if(b_rx_ready){
     b_rx_ready = 0;
-    radio.read(&dataIn, sizeof(dataIn));
+    if (radioRead())
+        preloadAck();
     #ifdef DEBUG
         Serial.println("data available");
         printf("Current command: %d\n\r", dataIn.senCommand);
@@ -641,7 +658,7 @@ void loop() {
           #endif
         break;      
       }// end switch
-      FastLED.show();
+      showLeds();
       /* delay om uitvoering te vertragen tot 40Hz
       * uitvoering wordt vertraagd met 25 ms 
       * We gaan er van uit dat al de rest "instant" wordt uitgevoerd. 
@@ -669,6 +686,7 @@ void loop() {
             printf("\n\rdata send: %d\n\r", dataOut.saturation);
           #endif
           radio.startListening();
+          preloadAck(); //startListening() flushed the ACK payload
 
           fill_solid(leds, NUM_LEDS, CHSV(deskHue, deskSat, deskInt));
           
@@ -688,6 +706,7 @@ void loop() {
             printf("\n\rdata send: %d\n\r", dataOut.saturation);
           #endif
           radio.startListening();
+          preloadAck(); //startListening() flushed the ACK payload
 
           fill_solid(leds, NUM_LEDS, CHSV(deskHue, deskSat, deskInt));
           break;
@@ -706,6 +725,7 @@ void loop() {
             printf("\n\rdata send: %d\n\r", dataOut.saturation);
           #endif
           radio.startListening();
+          preloadAck(); //startListening() flushed the ACK payload
 
           fill_solid(leds, NUM_LEDS, CHSV(deskHue, deskSat, deskInt));
           break;
@@ -751,7 +771,7 @@ void loop() {
         printf("Display LED\n\r");
       #endif
 
-      FastLED.show();
+      showLeds();
       /* delay om uitvoering te vertragen tot 40Hz
       * uitvoering wordt vertraagd met 25 ms 
       * We gaan er van uit dat al de rest "instant" wordt uitgevoerd. 
@@ -803,6 +823,108 @@ void accelRead(void){
       //constrain(mappedReadings[j], -128, 127);
 }
 
+/* leest de ontvangen payload in dataIn.
+   Van een broadcast frame wordt enkel de slice van deze node bewaard.
+   geeft false terug wanneer er geen data voor deze node was
+*/
+bool radioRead(void){
+  uint8_t pipe;
+  uint8_t len;
+  nodeSlice* p_slice;
+
+  if (!radio.available(&pipe))
+    return false;
+
+  lastRxMillis = millis();
+  if (pipe != BROADCAST_PIPE){
+    radio.read(&dataIn, sizeof(dataIn));
+    if (!RF_FRAME_VALID(dataIn.header) || RF_FRAME_TYPE(dataIn.header) != RF_FRAME_DATA)
+      return false;
+    traceReceived(dataIn.seq, dataIn.stamp);
+    return true;
+  }
+
+  len = radio.getDynamicPayloadSize(); //frame only holds nodeCount slices
+  if (len > sizeof(broadcastIn))
+    len = sizeof(broadcastIn);
+  radio.read(&broadcastIn, len);
+  if (!RF_FRAME_VALID(broadcastIn.header))
+    return false; //andere versie van radioFrame.h
+  if (RF_FRAME_TYPE(broadcastIn.header) == RF_FRAME_CHANNEL){
+    uint8_t r;
+    memcpy(&channelIn, &broadcastIn, sizeof(channelIn));
+    if (channelIn.nodesPerRadio == 0)
+      return false;
+    r = (localAddr - 1) / channelIn.nodesPerRadio; //radio van de masterNode die deze node bedient
+    if (r >= RF_RADIO_MAX || len < offsetof(channelStruct, channel) + r + 1)
+      return false;
+    if (channelIn.channel[r] != rfChannel && channelIn.channel[r] <= 125){
+      rfChannel = channelIn.channel[r];
+      radio.setChannel(rfChannel);
+    }
+    return false;
+  }
+  if (RF_FRAME_TYPE(broadcastIn.header) != RF_FRAME_BROADCAST || localAddr <= broadcastIn.firstNode || localAddr > broadcastIn.firstNode + broadcastIn.nodeCount)
+    return false;
+  if (len < offsetof(broadcastStruct, slice) + (localAddr - broadcastIn.firstNode) * sizeof(nodeSlice))
+    return false;
+
+  p_slice = &broadcastIn.slice[localAddr - 1 - broadcastIn.firstNode];
+  dataIn.srcNode = 0; //masterNode
+  dataIn.destNode = localAddr;
+  dataIn.senCommand = p_slice->senCommand;
+  dataIn.hue = p_slice->hue;
+  dataIn.saturation = p_slice->saturation;
+  dataIn.intensity = p_slice->intensity;
+  traceReceived(broadcastIn.seq, broadcastIn.stamp);
+  return true;
+}
+
+/* bewaart de ontvangsttijd van een traced frame */
+void traceReceived(uint8_t seq, uint16_t stamp){
+  if (seq == RF_TRACE_NONE)
+    return;
+  traceSeq = seq;
+  traceStamp = stamp;
+  traceRxMicros = micros();
+  tracePending = true;
+}
+
+/* toont de LEDs, de eerste show() na een traced frame wordt gerapporteerd in de ACK payload */
+void showLeds(void){
+  unsigned long showUs;
+
+  FastLED.show();
+  if (!tracePending)
+    return;
+  tracePending = false;
+  showUs = micros() - traceRxMicros;
+  ackOut.seq = traceSeq;
+  ackOut.stamp = traceStamp;
+  ackOut.showUs = (showUs < RF_SHOW_NONE) ? showUs : RF_SHOW_NONE - 1;
+  preloadAck();
+}
+
+/* laadt de laatste sensorwaarde als ACK payload op pipe 0 (adres van de masterNode commando's).
+   oude payloads worden eerst verwijderd zodat de masterNode steeds de recentste waarde krijgt
+*/
+void preloadAck(void){
+  ackOut.srcNode = localAddr;
+  ackOut.senCommand = dataIn.senCommand;
+  ackOut.sensorVal = AXIS;
+
+  radio.flush_tx();
+  radio.writeAckPayload(0, &ackOut, sizeof(ackOut));
+}
+
+/* keert terug naar het rendezvous kanaal wanneer de masterNode niet meer gehoord wordt */
+void radioWatchdog(void){
+  if (rfChannel != RF_RENDEZVOUS_CHANNEL && millis() - lastRxMillis > RF_LOST_MS){
+    rfChannel = RF_RENDEZVOUS_CHANNEL;
+    radio.setChannel(rfChannel);
+  }
+}
+
 void nRF_IRQ() {
   noInterrupts();
   radio.whatHappened(b_tx_ok, b_tx_fail, b_rx_ready);
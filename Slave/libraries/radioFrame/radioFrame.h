@@ -0,0 +1,162 @@
+/*
+ * radioFrame.h
+ *
+ * On-air frame format shared by the masterNode (ASF project) and the slave sketches.
+ * The masterNode adds this folder to its include paths, the slave sketches find it as a library
+ * when the Slave folder is used as sketchbook (Slave/libraries).
+ *
+ * Every frame starts with one header byte: frame version (bit 7-4) and frame type (bit 3-0).
+ * Receivers drop frames of another version, so master and slaves built from different revisions
+ * of this file ignore each other instead of misreading fields.
+ * All fields are at fixed offsets, the layout does not depend on enum sizes or padding of the compiler
+ * (arm-gcc, avr-gcc, arm-none-eabi for the SAMD21). 16 bit fields are little endian, like all three targets.
+ *
+ * Latency trace: command frames carry a sequence number and the 16 bit masterNode timestamp of the Art-Net
+ * frame they were built from. A slave echoes both in its sensorStruct together with the time from
+ * receiving the frame to the end of FastLED.show(). Sequence number RF_TRACE_NONE marks untraced frames
+ * (keepalive refreshes).
+ */
+
+
+#ifndef RADIO_FRAME_H_
+#define RADIO_FRAME_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+#define RF_STATIC_ASSERT(expr, msg)	static_assert(expr, msg)
+#else
+#define RF_STATIC_ASSERT(expr, msg)	_Static_assert(expr, msg)
+#endif
+#define RF_PACKED               __attribute__((packed))
+
+/** Frame header: version in the high nibble, type in the low nibble. */
+#define RF_FRAME_VERSION        2
+#define RF_FRAME_HEADER(type)   ((uint8_t)((RF_FRAME_VERSION << 4) | (type)))
+#define RF_FRAME_VER(header)    ((uint8_t)(header) >> 4)
+#define RF_FRAME_TYPE(header)   ((uint8_t)(header) & 0x0F)
+#define RF_FRAME_VALID(header)  (RF_FRAME_VER(header) == RF_FRAME_VERSION)
+
+#define RF_FRAME_DATA           0 //struct dataStruct, command for one node
+#define RF_FRAME_SENSOR         1 //struct sensorStruct, ACK payload of a node
+#define RF_FRAME_BROADCAST      2 //struct broadcastStruct, commands for a block of nodes
+#define RF_FRAME_CHANNEL        3 //struct channelStruct, RF channel announcement
+
+#define RF_TRACE_NONE           0 //seq of an untraced frame, traced frames count 1 to 255
+#define RF_SHOW_NONE            0xFFFF //showUs of a sensorStruct without trace report
+
+/* Command enumeration.
+   Sent as one byte (e_command), the enum only names the values. */
+enum sensorCommand {
+	disabled = 0,
+	active_hue,
+	active_sat,
+	active_int,
+	receive_hue,
+	receive_sat,
+	receive_int,
+	reset
+};
+typedef uint8_t e_command;
+
+/* Data frame (RF_FRAME_DATA), 11 bytes.
+   offset 0  header
+   offset 1  srcNode      node the data originates from (0 = masterNode)
+   offset 2  destNode     node the data is destined for
+   offset 3  senCommand   command, see enum sensorCommand
+   offset 4  intensity    intensity of the LEDs
+   offset 5  hue          color of the LEDs transcoded in a hue
+   offset 6  saturation   saturation of the colors
+   offset 7  sensorVal    sensor value to use in calculations (-128 to 127)
+   offset 8  seq          trace sequence number, RF_TRACE_NONE when untraced
+   offset 9  stamp        masterNode timestamp of the Art-Net frame (latency.h) */
+struct dataStruct {
+	uint8_t header;
+	uint8_t srcNode;
+	uint8_t destNode;
+	e_command senCommand;
+	uint8_t intensity;
+	uint8_t hue;
+	uint8_t saturation;
+	int8_t sensorVal;
+	uint8_t seq;
+	uint16_t stamp;
+} RF_PACKED;
+
+/* Sensor uplink (RF_FRAME_SENSOR), 9 bytes.
+   Preloaded by every slave as ACK payload, the next command of the masterNode takes it back.
+   offset 0  header
+   offset 1  srcNode      node the value originates from
+   offset 2  senCommand   command the node is executing
+   offset 3  sensorVal    mapped accelerometer reading (-128 to 127)
+   offset 4  seq          seq of the last traced frame shown on the LEDs
+   offset 5  stamp        stamp of that frame, echoed
+   offset 7  showUs       us from receiving that frame to the end of FastLED.show(), RF_SHOW_NONE without report */
+struct sensorStruct {
+	uint8_t header;
+	uint8_t srcNode;
+	e_command senCommand;
+	int8_t sensorVal;
+	uint8_t seq;
+	uint16_t stamp;
+	uint16_t showUs;
+} RF_PACKED;
+
+/* Broadcast frame (RF_FRAME_BROADCAST), 7 + 4 * nodeCount bytes, at most 32.
+   Sent by the masterNode without ACK to broadcastPipe, every slave keeps the slice of its own node.
+   offset 0  header
+   offset 1  destNode     BROADCAST_NODE
+   offset 2  firstNode    node of slice[0] minus 1
+   offset 3  nodeCount    number of valid slices, only those are sent (dynamic payload length)
+   offset 4  seq          trace sequence number, RF_TRACE_NONE when untraced
+   offset 5  stamp        masterNode timestamp of the Art-Net frame
+   offset 7  slice[]      senCommand, hue, saturation, intensity per node */
+#define BROADCAST_NODE          0xFF
+#define BROADCAST_SLICES        6
+struct nodeSlice {
+	e_command senCommand;
+	uint8_t hue;
+	uint8_t saturation;
+	uint8_t intensity;
+} RF_PACKED;
+struct broadcastStruct {
+	uint8_t header;
+	uint8_t destNode;
+	uint8_t firstNode;
+	uint8_t nodeCount;
+	uint8_t seq;
+	uint16_t stamp;
+	struct nodeSlice slice[BROADCAST_SLICES];
+} RF_PACKED;
+
+/* Channel announcement (RF_FRAME_CHANNEL), 3 + radios bytes.
+   Sent by the masterNode to broadcastPipe on the rendezvous channel.
+   offset 0  header
+   offset 1  destNode       CHANNEL_NODE
+   offset 2  nodesPerRadio  node n (0 based) listens on channel[n / nodesPerRadio]
+   offset 3  channel[]      RF channel per radio of the masterNode, only the active radios are sent */
+#define CHANNEL_NODE            0xFE
+#define RF_RADIO_MAX            4
+struct channelStruct {
+	uint8_t header;
+	uint8_t destNode;
+	uint8_t nodesPerRadio;
+	uint8_t channel[RF_RADIO_MAX];
+} RF_PACKED;
+
+#define RF_PAYLOAD_MAX          32 //nRF24 payload limit
+
+RF_STATIC_ASSERT(sizeof(struct dataStruct) == 11, "dataStruct is 11 bytes on air");
+RF_STATIC_ASSERT(offsetof(struct dataStruct, senCommand) == 3, "dataStruct command at offset 3");
+RF_STATIC_ASSERT(offsetof(struct dataStruct, sensorVal) == 7, "dataStruct sensorVal at offset 7");
+RF_STATIC_ASSERT(offsetof(struct dataStruct, stamp) == 9, "dataStruct stamp at offset 9");
+RF_STATIC_ASSERT(sizeof(struct sensorStruct) == 9, "sensorStruct is 9 bytes on air");
+RF_STATIC_ASSERT(offsetof(struct sensorStruct, showUs) == 7, "sensorStruct showUs at offset 7");
+RF_STATIC_ASSERT(sizeof(struct nodeSlice) == 4, "nodeSlice is 4 bytes on air");
+RF_STATIC_ASSERT(offsetof(struct broadcastStruct, slice) == 7, "broadcast slices start at offset 7");
+RF_STATIC_ASSERT(sizeof(struct broadcastStruct) <= RF_PAYLOAD_MAX, "broadcastStruct exceeds the nRF24 payload");
+RF_STATIC_ASSERT(offsetof(struct channelStruct, channel) == 3, "channel list starts at offset 3");
+RF_STATIC_ASSERT(sizeof(struct channelStruct) <= RF_PAYLOAD_MAX, "channelStruct exceeds the nRF24 payload");
+
+#endif /* RADIO_FRAME_H_ */